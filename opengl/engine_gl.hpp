@@ -39,6 +39,13 @@
 #define ZOOM_SENSITIVITY 3.0f
 #define KEY_SCAN_DELAY_us 1000
 
+// 每帧的视锥剔除统计, 在update()中清零
+struct DrawStats
+{
+    unsigned int drawn = 0;
+    unsigned int culled = 0;
+};
+
 // OpenGL 4.6 core
 class Engine
 {
@@ -215,6 +222,7 @@ public:
     static glm::vec3 eye;
     static glm::vec3 worldUp;
     static std::bitset<(int)Mapping_bitset::amount> keyMapping;
+    static DrawStats drawStats;
 
     static Engine &get()
     {
@@ -333,6 +341,7 @@ public:
         double curShadeTime = glfwGetTime();
         deltaShadeTime = curShadeTime - lastShadeTime;
         lastShadeTime = curShadeTime;
+        drawStats = DrawStats{};
         glClearColor(BACKGROUND_RED, BACKGROUND_GREEN, BACKGROUND_BLUE, BACKGROUND_ALPHA);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glEnable(GL_DEPTH_TEST);
@@ -352,19 +361,36 @@ public:
         shader.setMat4("view", glm::lookAt(eye, eye + front, up));
         shader.setMat4("projection", glm::perspective(glm::radians(fovy), aspect, nearLimit, farLimit));
         mesh.draw(shader.getID());
+        ++drawStats.drawn;
     }
+    // culling为true时用模型八叉树做视锥剔除, 只画可见的mesh
     void draw(const std::string &shaderName,
               const Model &model,
-              const glm::mat4 &globalMat = glm::mat4(1.0f)) const
+              const glm::mat4 &globalMat = glm::mat4(1.0f),
+              bool culling = true) const
     {
         auto &shader = shaders_.at(shaderName);
         auto ID = shader.getID();
+        glm::mat4 view = glm::lookAt(eye, eye + front, up);
+        glm::mat4 projection = glm::perspective(glm::radians(fovy), aspect, nearLimit, farLimit);
         shader.use();
         shader.setMat4("model", globalMat);
-        shader.setMat4("view", glm::lookAt(eye, eye + front, up));
-        shader.setMat4("projection", glm::perspective(glm::radians(fovy), aspect, nearLimit, farLimit));
-        for (auto &mesh : model.getMeshes())
-            mesh.draw(ID);
+        shader.setMat4("view", view);
+        shader.setMat4("projection", projection);
+        if (!culling || !model.getOctree().isBuilt())
+        {
+            for (auto &mesh : model.getMeshes())
+                mesh.draw(ID);
+            drawStats.drawn += static_cast<unsigned int>(model.getMeshes().size());
+            return;
+        }
+        unsigned int drawn = 0;
+        model.getOctree().query(Frustum(projection * view * globalMat), [&](void *where)
+                                {
+                                    static_cast<const Mesh *>(where)->draw(ID);
+                                    ++drawn; });
+        drawStats.drawn += drawn;
+        drawStats.culled += static_cast<unsigned int>(model.getMeshes().size()) - drawn;
     }
     void draw(const std::string &shaderName,
               const std::string &deliverName,
@@ -379,8 +405,9 @@ public:
         shader.setMat4("view", glm::lookAt(eye, eye + front, up));
         shader.setMat4("projection", glm::perspective(glm::radians(fovy), aspect, nearLimit, farLimit));
         deliver.deliverTransforms(ID);
-        for (auto &mesh : animator.getMeshes())
+        for (auto &mesh : animator.getMeshes()) // 骨骼动画会改变顶点位置, 静态包围盒不可信, 不剔除
             mesh.draw(ID);
+        drawStats.drawn += static_cast<unsigned int>(animator.getMeshes().size());
     }
     void showNpoll() const
     {
@@ -483,6 +510,7 @@ glm::vec3 Engine::right(1.0f, 0.0f, 0.0f);
 glm::vec3 Engine::eye(EYE_X, EYE_HEIGHT, EYE_Y);
 glm::vec3 Engine::worldUp(0.0f, 1.0f, 0.0f);
 std::bitset<(int)Mapping_bitset::amount> Engine::keyMapping{};
+DrawStats Engine::drawStats{};
 #endif
 
 #endif
@@ -3,9 +3,14 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <glm/gtx/intersect.hpp>
 #include <glad/glad.h>
 #include "octree.hpp"
+#include "bvh.hpp"
 
 #define MAX_BONE_INFLUENCE 4
 
@@ -27,6 +32,27 @@ struct Texture
     std::string path;
 };
 
+class Mesh;
+
+// 射线命中的三角形, 交点 = (1 - u - v) * v0 + u * v1 + v * v2, 其中barycentric = (u, v)
+struct RayHit
+{
+    float distance = 0.0f;
+    unsigned int triangle = 0; // 顶点下标为indices[3 * triangle], [3 * triangle + 1], [3 * triangle + 2]
+    glm::vec2 barycentric = glm::vec2(0.0f);
+    const Mesh *mesh = nullptr;
+};
+
+// 离查询点最近的三角形, point为三角形上的最近点, point = (1 - u - v) * v0 + u * v1 + v * v2
+struct ClosestHit
+{
+    float distance = 0.0f;
+    unsigned int triangle = 0;
+    glm::vec2 barycentric = glm::vec2(0.0f);
+    glm::vec3 point = glm::vec3(0.0f);
+    const Mesh *mesh = nullptr;
+};
+
 class Mesh
 {
     // base data
@@ -34,7 +60,8 @@ class Mesh
     std::vector<GLuint> indices_;
     std::vector<Texture> textures_;
     // AABB attributes
-    Octree octree_;
+    TriangleOctree octree_;
+    TriangleBVH bvh_; // 非空时代替octree_回答三角形查询
     // shade attributes
     GLuint VAO_;
     GLuint VBO_;
@@ -47,12 +74,14 @@ public:
     Mesh(std::vector<Vertex> &&vertices,
          std::vector<GLuint> &&indices,
          std::vector<Texture> &&textures,
-         Octree &&octree,
-         const std::string &name)
+         TriangleOctree &&octree,
+         const std::string &name,
+         TriangleBVH &&bvh = TriangleBVH())
         : vertices_(std::move(vertices)),
           indices_(std::move(indices)),
           textures_(std::move(textures)),
           octree_(std::move(octree)),
+          bvh_(std::move(bvh)),
           VAO_(0),
           VBO_(0),
           EBO_(0),
@@ -89,6 +118,7 @@ public:
           indices_(std::move(other.indices_)),
           textures_(std::move(other.textures_)),
           octree_(std::move(other.octree_)),
+          bvh_(std::move(other.bvh_)),
           VAO_(other.VAO_),
           VBO_(other.VBO_),
           EBO_(other.EBO_),
@@ -129,16 +159,134 @@ public:
     inline const std::vector<Vertex> &getVertices() const { return vertices_; }
     inline const std::vector<GLuint> &getIndices() const { return indices_; }
     inline const std::vector<Texture> &getTextures() const { return textures_; }
-    inline const Octree &getOctree() const { return octree_; }
+    inline const TriangleOctree &getOctree() const { return octree_; }
+    inline const TriangleBVH &getBVH() const { return bvh_; }
     inline const std::string &getName() const { return name_; }
+    // 三角形范围查询, 由构建时选择的加速结构回答; range可以是Bounds, Sphere或Capsule
+    // visitor收到的是三角形序号(std::uint32_t), 顶点下标为indices_[3 * 序号 + 0, 1, 2], 不分配内存
+    template <typename Range, typename Visitor>
+    inline void query(const Range &range, Visitor &&visitor) const
+    {
+        if (bvh_.empty())
+            octree_.query(range, visitor);
+        else
+            bvh_.query(range, visitor);
+    }
+    // 第triangle个三角形的三个顶点下标
+    inline const GLuint *getTriangle(std::uint32_t triangle) const { return indices_.data() + 3 * static_cast<std::size_t>(triangle); }
+    // 最近命中(模型空间), 只在比maxDistance近时写入hit
+    bool raycast(const Ray &ray, float maxDistance, RayHit &hit) const
+    {
+        bool found = false;
+        traceRay(ray, maxDistance, [&](std::uint32_t triangle, float distance, const glm::vec2 &barycentric, float &tMax)
+                 {
+                     tMax = distance;
+                     hit.distance = distance;
+                     hit.triangle = triangle;
+                     hit.barycentric = barycentric;
+                     hit.mesh = this;
+                     found = true;
+                     return false; });
+        return found;
+    }
+    // 任意命中, 用于视线遮挡等只关心有无的场合
+    bool raycastAny(const Ray &ray, float maxDistance) const
+    {
+        return traceRay(ray, maxDistance, [](std::uint32_t, float, const glm::vec2 &, float &)
+                        { return true; });
+    }
+    // 最近点(模型空间), 只在比maxDistance近时写入hit; 用于穿透修正与球体接触
+    bool closestPoint(const glm::vec3 &point, float maxDistance, ClosestHit &hit) const
+    {
+        bool found = false;
+        traceNearest(point, maxDistance, [&](const ClosestHit &candidate, float &maxDistance2)
+                     {
+                         maxDistance2 = candidate.distance * candidate.distance;
+                         hit = candidate;
+                         found = true; });
+        return found;
+    }
+    // k个最近三角形, 按距离升序并入result: result中已有的结果(比如其他网格的)一起比较, 最多保留k个
+    void nearest(const glm::vec3 &point, std::size_t k, float maxDistance, std::vector<ClosestHit> &result) const
+    {
+        if (0 == k)
+            return;
+        if (result.size() >= k)
+        {
+            result.resize(k);
+            maxDistance = std::min(maxDistance, result.back().distance);
+        }
+        traceNearest(point, maxDistance, [&](const ClosestHit &candidate, float &maxDistance2)
+                     {
+                         auto it = std::upper_bound(result.begin(), result.end(), candidate.distance, [](float distance, const ClosestHit &hit)
+                                                    { return distance < hit.distance; });
+                         result.insert(it, candidate);
+                         if (result.size() > k)
+                             result.pop_back();
+                         if (result.size() == k)
+                             maxDistance2 = result.back().distance * result.back().distance; });
+    }
 
 private:
+    // visitor(const ClosestHit &, float &maxDistance2)只收到比当前maxDistance2近的三角形
+    template <typename Visitor>
+    void traceNearest(const glm::vec3 &point, float maxDistance, Visitor &&visitor) const
+    {
+        auto handle = [&](std::uint32_t where, float &maxDistance2)
+        {
+            auto triangle = getTriangle(where);
+            ClosestHit candidate;
+            candidate.point = closestPointOnTriangle(point,
+                                                     vertices_[triangle[0]].position,
+                                                     vertices_[triangle[1]].position,
+                                                     vertices_[triangle[2]].position,
+                                                     candidate.barycentric);
+            glm::vec3 offset = candidate.point - point;
+            float distance2 = glm::dot(offset, offset);
+            if (distance2 > maxDistance2)
+                return;
+            candidate.distance = std::sqrt(distance2);
+            candidate.triangle = where;
+            candidate.mesh = this;
+            visitor(candidate, maxDistance2);
+        };
+        if (!bvh_.empty())
+            bvh_.nearest(point, maxDistance * maxDistance, handle);
+        else if (octree_.isBuilt())
+            octree_.nearest(point, maxDistance * maxDistance, handle);
+    }
+    template <typename Visitor>
+    bool traceRay(const Ray &ray, float maxDistance, Visitor &&visitor) const
+    {
+        auto handle = [&](std::uint32_t where, float &tMax)
+        {
+            auto triangle = getTriangle(where);
+            glm::vec2 barycentric;
+            float distance = 0.0f;
+            if (!glm::intersectRayTriangle(ray.origin,
+                                           ray.direction,
+                                           vertices_[triangle[0]].position,
+                                           vertices_[triangle[1]].position,
+                                           vertices_[triangle[2]].position,
+                                           barycentric,
+                                           distance) ||
+                distance < 0.0f || distance > tMax)
+                return false;
+            return visitor(where, distance, barycentric, tMax);
+        };
+        if (!bvh_.empty())
+            return bvh_.raycast(ray, maxDistance, handle);
+        if (octree_.isBuilt())
+            return octree_.raycast(ray, maxDistance, handle);
+        return false;
+    }
     void swap(Mesh &other)
     {
         std::swap(vertices_, other.vertices_);
         std::swap(indices_, other.indices_);
         std::swap(textures_, other.textures_);
         std::swap(octree_, other.octree_);
+        std::swap(bvh_, other.bvh_);
         std::swap(VAO_, other.VAO_);
         std::swap(VBO_, other.VBO_);
         std::swap(EBO_, other.EBO_);
@@ -0,0 +1,309 @@
+#ifndef TEXTURE_GL_HPP
+#define TEXTURE_GL_HPP
+
+#include <cassert>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <ostream>
+#include <optional>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#include <glad/glad.h>
+#include "texture_decoder.hpp"
+
+// S3TC不在core profile里, 驱动普遍支持EXT_texture_compression_s3tc; 不支持时BC格式的烘焙文件被跳过, 改为解码原图
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// 纹理表的计数, 由TextureRegistry::getStats()返回
+struct TextureStats
+{
+    std::size_t pathHits = 0;      // 按路径命中
+    std::size_t contentHits = 0;   // 路径不同但文件内容相同
+    std::size_t misses = 0;        // 解码并上传
+    std::size_t textures = 0;      // 当前存活的GL纹理数
+    std::size_t bytes = 0;         // 当前存活纹理的显存(含mipmap, 估算)
+    std::size_t uploadedBytes = 0; // 累计上传
+    double loadMs = 0.0;           // acquire(含分步的begin/step/finish)在调用线程上的累计墙钟时间
+
+    void print(std::ostream &out) const
+    {
+        out << "textures:" << textures << " path hits:" << pathHits << " content hits:" << contentHits
+            << " misses:" << misses << " bytes:" << bytes << " uploaded:" << uploadedBytes
+            << " load:" << loadMs << "ms" << std::endl;
+    }
+};
+
+// 进程内共享的纹理表: 按规范化路径O(1)查找, 路径没见过时再按文件内容的哈希查找
+// 同一张图只解码上传一次, 所有模型共用一个GL纹理, 引用计数归零时才删除
+// 会调用GL, 只能在上下文线程上使用; 解码交给TextureDecoder的工作线程
+class TextureRegistry
+{
+    struct Entry
+    {
+        std::size_t refs = 0;
+        std::size_t bytes = 0;
+        std::size_t fileSize = 0;
+        std::uint64_t hash = 0;
+        std::vector<std::string> paths; // 指向这个纹理的所有路径
+    };
+    std::unordered_map<std::string, GLuint> paths_;
+    std::unordered_map<std::uint64_t, GLuint> hashes_;
+    std::unordered_map<GLuint, Entry> entries_;
+    TextureStats stats_;
+    std::optional<bool> s3tc_; // 第一次begin()时查询, 此时上下文已创建
+
+    TextureRegistry() = default;
+
+public:
+    ~TextureRegistry() = default;
+    TextureRegistry(const TextureRegistry &) = delete;
+    TextureRegistry &operator=(const TextureRegistry &) = delete;
+    TextureRegistry(TextureRegistry &&) = delete;
+    TextureRegistry &operator=(TextureRegistry &&) = delete;
+    static TextureRegistry &get()
+    {
+        static TextureRegistry instance;
+        return instance;
+    }
+    // 返回共享的GL纹理并加一次引用, 用完交给release()
+    inline GLuint acquire(const std::filesystem::path &path)
+    {
+        return acquire(std::vector<std::filesystem::path>{path}, 0).front();
+    }
+    // 批量acquire, 每个路径各加一次引用, 计数与逐个调用相同
+    // 没见过的路径交给threads个线程解码, 当前线程按解码完成的顺序上传; threads为0时串行
+    std::vector<GLuint> acquire(const std::vector<std::filesystem::path> &paths, unsigned int threads)
+    {
+        Batch batch = begin(paths, threads);
+        while (step(batch, true))
+            ;
+        return finish(batch);
+    }
+
+    // 分步进行的批量acquire: begin()后反复step(), 每次最多上传一张, done()后finish()取得结果
+    // 用于把上传分摊到多帧(见ModelLoader); 多个Batch可以同时进行
+    class Batch
+    {
+        friend class TextureRegistry;
+        std::vector<GLuint> ids_;
+        std::vector<std::string> keys_;
+        std::vector<std::size_t> owners_;                    // 解码器输入第i项在paths中的序号
+        std::unordered_map<std::string, std::size_t> batch_; // 本批内第一次出现的位置, 之后的同路径等它上传完
+        std::unique_ptr<TextureDecoder> decoder_;
+
+    public:
+        inline bool done() const { return decoder_->done(); }
+    };
+    Batch begin(const std::vector<std::filesystem::path> &paths, unsigned int threads)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        Batch batch;
+        batch.ids_.assign(paths.size(), 0);
+        batch.keys_.resize(paths.size());
+        std::vector<std::filesystem::path> missing;
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            batch.keys_[i] = getKey(paths[i]);
+            if (auto it = paths_.find(batch.keys_[i]); it != paths_.end())
+            {
+                ++stats_.pathHits;
+                ++entries_.at(it->second).refs;
+                batch.ids_[i] = it->second;
+            }
+            else if (batch.batch_.emplace(batch.keys_[i], i).second)
+            {
+                missing.push_back(paths[i]);
+                batch.owners_.push_back(i);
+            }
+        }
+        batch.decoder_ = std::make_unique<TextureDecoder>(std::move(missing), threads, supportsS3TC());
+        stats_.loadMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        return batch;
+    }
+    // 取一张解码完成的图上传; wait为false时没有就绪的图立即返回false
+    bool step(Batch &batch, bool wait)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        DecodedImage image;
+        if (!batch.decoder_->pop(image, wait))
+            return false;
+        std::size_t owner = batch.owners_[image.index];
+        auto &key = batch.keys_[owner];
+        if (auto it = paths_.find(key); it != paths_.end())
+        {
+            // begin()之后被别的Batch上传了
+            ++stats_.pathHits;
+            ++entries_.at(it->second).refs;
+            batch.ids_[owner] = it->second;
+        }
+        else if (auto it = hashes_.find(image.hash); it != hashes_.end() && entries_.at(it->second).fileSize == image.fileSize)
+        {
+            ++stats_.contentHits;
+            auto &entry = entries_.at(it->second);
+            ++entry.refs;
+            entry.paths.push_back(key);
+            paths_.emplace(key, it->second);
+            batch.ids_[owner] = it->second;
+        }
+        else
+        {
+            std::size_t bytes = 0;
+            GLuint id = upload(image, bytes);
+            ++stats_.misses;
+            ++stats_.textures;
+            stats_.bytes += bytes;
+            stats_.uploadedBytes += bytes;
+            entries_.emplace(id, Entry{1, bytes, image.fileSize, image.hash, {key}});
+            paths_.emplace(key, id);
+            hashes_.emplace(image.hash, id);
+            batch.ids_[owner] = id;
+        }
+        stats_.loadMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        return true;
+    }
+    // 批内重复的路径引用第一次出现的结果, 返回与paths一一对应的纹理
+    std::vector<GLuint> finish(Batch &batch)
+    {
+        assert(batch.done());
+        for (std::size_t i = 0; i < batch.ids_.size(); ++i)
+            if (0 == batch.ids_[i])
+            {
+                ++stats_.pathHits;
+                batch.ids_[i] = batch.ids_[batch.batch_.at(batch.keys_[i])];
+                ++entries_.at(batch.ids_[i]).refs;
+            }
+        return std::move(batch.ids_);
+    }
+    // 放弃没有finish()的Batch: 停止解码, 已取得的引用逐个交还, 之后这个Batch不能再用
+    void cancel(Batch &batch)
+    {
+        batch.decoder_.reset();
+        for (auto id : batch.ids_)
+            if (0 != id)
+                release(id);
+        batch.ids_.clear();
+    }
+    // 减一次引用, 归零时删除GL纹理
+    void release(GLuint id)
+    {
+        auto it = entries_.find(id);
+        if (it == entries_.end() || --it->second.refs > 0)
+            return;
+        for (auto &path : it->second.paths)
+            paths_.erase(path);
+        if (auto hash = hashes_.find(it->second.hash); hash != hashes_.end() && hash->second == id)
+            hashes_.erase(hash);
+        --stats_.textures;
+        stats_.bytes -= it->second.bytes;
+        entries_.erase(it);
+        glDeleteTextures(1, &id);
+    }
+    inline const TextureStats &getStats() const { return stats_; }
+
+private:
+    bool supportsS3TC()
+    {
+        if (!s3tc_)
+        {
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            s3tc_ = false;
+            for (GLint i = 0; i < count && !*s3tc_; ++i)
+                s3tc_ = 0 == std::strcmp(reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i)), "GL_EXT_texture_compression_s3tc");
+        }
+        return *s3tc_;
+    }
+    static std::string getKey(const std::filesystem::path &path)
+    {
+        std::error_code ec;
+        auto canonical = std::filesystem::weakly_canonical(path, ec);
+        return ec ? path.lexically_normal().generic_string() : canonical.generic_string();
+    }
+    static GLuint upload(const DecodedImage &image, std::size_t &bytes)
+    {
+        GLuint textureID;
+        glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+        glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (!image.baked.empty())
+        {
+            uploadBaked(textureID, image.baked);
+            bytes = image.baked.bytes();
+            return textureID;
+        }
+        int width = image.width, height = image.height;
+        GLenum format;
+        switch (image.comp)
+        {
+        case 1:
+            format = GL_RED;
+            break;
+        case 3:
+            format = GL_RGB;
+            break;
+        case 4:
+            format = GL_RGBA;
+            break;
+        default:
+            assert(false);
+        }
+        glTextureStorage2D(textureID, 1 + static_cast<int>(std::log2(std::max(width, height))), format == GL_RGBA ? GL_RGBA8 : GL_RGB8, width, height);
+        glTextureSubImage2D(textureID, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, image.pixels.get());
+        glGenerateTextureMipmap(textureID);
+        bytes = static_cast<std::size_t>(width) * height * (format == GL_RGBA ? 4 : 3) * 4 / 3; // mipmap链约多1/3
+        return textureID;
+    }
+    // 各层逐个上传, 不生成mipmap; 单通道用GL_R8, 不再扩成RGB8
+    static void uploadBaked(GLuint textureID, const BakedTexture &baked)
+    {
+        GLenum internalFormat, format = GL_RGBA;
+        switch (baked.format)
+        {
+        case BakedFormat::R8:
+            internalFormat = GL_R8;
+            format = GL_RED;
+            break;
+        case BakedFormat::RGB8:
+            internalFormat = GL_RGB8;
+            format = GL_RGB;
+            break;
+        case BakedFormat::RGBA8:
+            internalFormat = GL_RGBA8;
+            break;
+        case BakedFormat::BC1:
+            internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            break;
+        case BakedFormat::BC3:
+            internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            break;
+        default:
+            assert(false);
+        }
+        glTextureStorage2D(textureID, static_cast<GLsizei>(baked.levels.size()), internalFormat, baked.width, baked.height);
+        GLint alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // 小层级的行长不是4的倍数
+        for (int l = 0; l < static_cast<int>(baked.levels.size()); ++l)
+            if (baked.isCompressed())
+                glCompressedTextureSubImage2D(textureID, l, 0, 0, baked.levelWidth(l), baked.levelHeight(l), internalFormat,
+                                              static_cast<GLsizei>(baked.levels[l].size()), baked.levels[l].data());
+            else
+                glTextureSubImage2D(textureID, l, 0, 0, baked.levelWidth(l), baked.levelHeight(l), format, GL_UNSIGNED_BYTE, baked.levels[l].data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    }
+};
+
+#endif
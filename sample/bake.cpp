@@ -0,0 +1,103 @@
+#include <cassert>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <algorithm>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <stb/stb_image.h>
+#include "converter.hpp"
+#include "baked_texture.hpp"
+
+// 离线烘焙纹理: 生成全部mip层级(可选BC1/BC3压缩), 写在原图旁边, 运行时优先读取
+// 用法: my3D_bake [--compress] <模型或图片>...  模型会烘焙它的材质引用的所有纹理
+
+std::vector<std::filesystem::path> collectTextures(const std::filesystem::path &path)
+{
+    Assimp::Importer importer;
+    if (!importer.IsExtensionSupported(path.extension().string()))
+        return {path};
+    const aiScene *paiScene = importer.ReadFile(path, ASSIMP_IMPORT_FLAGS);
+    if (nullptr == paiScene)
+    {
+        std::cerr << "import failed: " << path << std::endl;
+        return {};
+    }
+    std::vector<std::filesystem::path> paths;
+    for (unsigned int m = 0; m < paiScene->mNumMaterials; ++m)
+        for (auto type : {aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT, aiTextureType_AMBIENT})
+            for (unsigned int i = 0; i < paiScene->mMaterials[m]->GetTextureCount(type); ++i)
+            {
+                aiString texture;
+                paiScene->mMaterials[m]->GetTexture(type, i, &texture);
+                paths.push_back(path.parent_path() / texture.C_Str());
+            }
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+    return paths;
+}
+
+// 返回烘焙后的字节数, 失败时返回0
+std::size_t bake(const std::filesystem::path &path, bool compress, std::size_t &runtimeBytes)
+{
+    int width, height, comp;
+    unsigned char *pImage = stbi_load(path.string().c_str(), &width, &height, &comp, 0);
+    if (nullptr == pImage)
+    {
+        std::cerr << "decode failed: " << path << std::endl;
+        return 0;
+    }
+    if (2 == comp) // 运行时也不支持灰度加alpha
+    {
+        std::cerr << "unsupported channels: " << path << std::endl;
+        stbi_image_free(pImage);
+        return 0;
+    }
+    BakedTexture baked = BakedTexture::bake(pImage, width, height, comp, compress);
+    stbi_image_free(pImage);
+    if (!baked.save(path))
+    {
+        std::cerr << "write failed: " << BakedTexture::getPath(path) << std::endl;
+        return 0;
+    }
+    // 未烘焙时运行时按RGB8/RGBA8分配, mipmap链约多1/3
+    runtimeBytes = static_cast<std::size_t>(width) * height * (4 == comp ? 4 : 3) * 4 / 3;
+    std::cout << path.filename().string() << " " << width << "x" << height << "x" << comp
+              << " levels:" << baked.levels.size() << " baked:" << baked.bytes()
+              << " unbaked:" << runtimeBytes << std::endl;
+    return baked.bytes();
+}
+
+int main(int argc, char **argv)
+{
+    bool compress = false;
+    std::vector<std::filesystem::path> inputs;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if ("--compress" == arg)
+            compress = true;
+        else
+            inputs.push_back(arg);
+    }
+    if (inputs.empty())
+    {
+        std::cerr << "usage: " << argv[0] << " [--compress] <model or image>..." << std::endl;
+        return 1;
+    }
+    std::size_t bakedTotal = 0, runtimeTotal = 0, failed = 0;
+    for (auto &input : inputs)
+        for (auto &path : collectTextures(input))
+        {
+            std::size_t runtimeBytes = 0;
+            std::size_t bytes = bake(path, compress, runtimeBytes);
+            if (0 == bytes)
+                ++failed;
+            bakedTotal += bytes;
+            runtimeTotal += runtimeBytes;
+        }
+    std::cout << "GPU bytes baked:" << bakedTotal << " unbaked:" << runtimeTotal << " failed:" << failed << std::endl;
+    return 0 == failed ? 0 : 1;
+}
@@ -0,0 +1,1058 @@
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <new>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include <optional>
+#include <glm/gtx/intersect.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "converter.hpp"
+#include "octree.hpp"
+#include "bvh.hpp"
+#include "bounds_soa.hpp"
+#include "octree_cache.hpp"
+#include "animation.hpp"
+#include "texture_decoder.hpp"
+#include "model_cache.hpp"
+#include "animator.hpp"
+#include "model_loader.hpp"
+
+// 基准测试, 网格数据只用assimp读取; 只有Model的加载一项需要GL上下文, 建不了时跳过(导入失败走不到GL, 不受影响)
+
+#define BENCH_QUERY_COUNT 200000
+#define BENCH_QUERY_EXTENT 0.5f
+#define BENCH_RAY_COUNT 2000
+#define BENCH_POINT_COUNT 2000
+#define BENCH_NEAREST_K 8
+#define BENCH_TUNE_MAX_DEPTH 8
+#define BENCH_TUNE_MAX_OBJECTS 32
+#define BENCH_BATCH_SIZES {1, 8, 64, 256}
+#define BENCH_IMPORT_ROUNDS 5
+#define BENCH_TERRAIN_EXTENT 100.0f
+#define BENCH_TERRAIN_AMPLITUDE 5.0f
+#define BENCH_TERRAIN_TILES {1, 2, 4, 8} // 每边切几块, 即1/4/16/64个网格
+
+// 统计堆分配次数, 用来验证查询路径不分配内存; 解码和构建的工作线程也在分配, 所以用原子计数
+static std::atomic<std::size_t> allocationCount = 0;
+void *operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+// std::pmr的默认上游资源按对齐方式分配, 一并统计
+void *operator new(std::size_t size, std::align_val_t align)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    std::size_t alignment = static_cast<std::size_t>(align);
+    if (void *p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+// 结果核对: 与assert不同, NDEBUG下照样检查; 有一项不通过时main返回1
+static int checkFailures = 0;
+#define BENCH_CHECK(condition) check((condition), #condition, __LINE__)
+bool check(bool passed, const char *condition, int line)
+{
+    if (!passed)
+    {
+        ++checkFailures;
+        std::cerr << "check failed: " << condition << " (bench.cpp:" << line << ")" << std::endl;
+    }
+    return passed;
+}
+
+struct BenchMesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+std::vector<BenchMesh> loadMeshes(const std::filesystem::path &path)
+{
+    Assimp::Importer importer;
+    const aiScene *paiScene = importer.ReadFile(path, ASSIMP_IMPORT_FLAGS);
+    if (nullptr == paiScene || (paiScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || nullptr == paiScene->mRootNode)
+    {
+        std::cerr << "import failed: " << path << " " << importer.GetErrorString() << std::endl;
+        std::exit(1);
+    }
+    std::vector<BenchMesh> meshes(paiScene->mNumMeshes);
+    for (unsigned int m = 0; m < paiScene->mNumMeshes; ++m)
+    {
+        auto paiMesh = paiScene->mMeshes[m];
+        auto &mesh = meshes[m];
+        mesh.positions.resize(paiMesh->mNumVertices);
+        for (unsigned int i = 0; i < paiMesh->mNumVertices; ++i)
+        {
+            mesh.positions[i] = Converter::getGLMVec(paiMesh->mVertices[i]);
+            if (i == 0)
+                mesh.min = mesh.max = mesh.positions[i];
+            else
+            {
+                mesh.min = glm::min(mesh.min, mesh.positions[i]);
+                mesh.max = glm::max(mesh.max, mesh.positions[i]);
+            }
+        }
+        mesh.indices.reserve(paiMesh->mNumFaces * 3);
+        for (unsigned int i = 0; i < paiMesh->mNumFaces; ++i)
+            for (unsigned int j = 0; j < 3; ++j)
+                mesh.indices.push_back(paiMesh->mFaces[i].mIndices[j]);
+    }
+    return meshes;
+}
+
+std::vector<Bounds> triangleBounds(const BenchMesh &mesh)
+{
+    std::vector<Bounds> triangles;
+    triangles.reserve(mesh.indices.size() / 3);
+    for (std::size_t i = 0; i < mesh.indices.size(); i += 3)
+    {
+        auto &v0 = mesh.positions[mesh.indices[i]];
+        auto &v1 = mesh.positions[mesh.indices[i + 1]];
+        auto &v2 = mesh.positions[mesh.indices[i + 2]];
+        triangles.emplace_back(glm::min(v0, glm::min(v1, v2)),
+                               glm::max(v0, glm::max(v1, v2)));
+    }
+    return triangles;
+}
+
+// 载荷与Model一致: 三角形序号
+std::vector<std::uint32_t> trianglePayloads(BenchMesh &mesh)
+{
+    std::vector<std::uint32_t> payloads(mesh.indices.size() / 3);
+    std::iota(payloads.begin(), payloads.end(), 0u);
+    return payloads;
+}
+
+// 旧的载荷: 三角形在indices中的首地址, 只用来对比拷贝查询与载荷的内存
+std::vector<void *> trianglePointers(BenchMesh &mesh)
+{
+    std::vector<void *> payloads(mesh.indices.size() / 3);
+    for (std::size_t i = 0; i < payloads.size(); ++i)
+        payloads[i] = mesh.indices.data() + i * 3;
+    return payloads;
+}
+
+TriangleOctree buildOctree(BenchMesh &mesh, const OctreeParams &params = OctreeParams())
+{
+    TriangleOctree octree(Bounds(mesh.min, mesh.max), params);
+    auto triangles = triangleBounds(mesh);
+    for (std::size_t i = 0; i < triangles.size(); ++i)
+        octree.insert(triangles[i], static_cast<std::uint32_t>(i));
+    return octree;
+}
+
+// 在网格包围盒内随机生成与碰撞体扫掠盒大小相近的查询盒
+std::vector<Bounds> makeQueries(const BenchMesh &mesh, int count)
+{
+    std::mt19937 rng(20240601);
+    std::uniform_real_distribution<float> dx(mesh.min.x, mesh.max.x);
+    std::uniform_real_distribution<float> dy(mesh.min.y, mesh.max.y);
+    std::uniform_real_distribution<float> dz(mesh.min.z, mesh.max.z);
+    std::vector<Bounds> queries;
+    queries.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        glm::vec3 centre(dx(rng), dy(rng), dz(rng));
+        queries.emplace_back(centre - glm::vec3(BENCH_QUERY_EXTENT), centre + glm::vec3(BENCH_QUERY_EXTENT));
+    }
+    return queries;
+}
+
+// 合成地形: 边长BENCH_TERRAIN_EXTENT, 每格两个三角形, 总数约为triangles, 切成tiles x tiles个网格
+// amplitude为起伏高度, 为0时完全平(y方向厚度为0)
+std::vector<BenchMesh> makeTerrain(std::size_t triangles, int tiles, float amplitude)
+{
+    int cells = std::max(1, static_cast<int>(std::lround(std::sqrt(triangles / 2.0))));
+    cells = (cells + tiles - 1) / tiles * tiles;
+    int per = cells / tiles;
+    float step = BENCH_TERRAIN_EXTENT / cells;
+    auto height = [&](int x, int z)
+    { return amplitude * std::sin(x * 0.3f) * std::cos(z * 0.2f); };
+    std::vector<BenchMesh> meshes(static_cast<std::size_t>(tiles) * tiles);
+    for (int tz = 0; tz < tiles; ++tz)
+        for (int tx = 0; tx < tiles; ++tx)
+        {
+            auto &mesh = meshes[tz * tiles + tx];
+            for (int z = 0; z <= per; ++z)
+                for (int x = 0; x <= per; ++x)
+                {
+                    int gx = tx * per + x, gz = tz * per + z;
+                    mesh.positions.emplace_back(gx * step, height(gx, gz), gz * step);
+                }
+            for (unsigned int z = 0; z < static_cast<unsigned int>(per); ++z)
+                for (unsigned int x = 0; x < static_cast<unsigned int>(per); ++x)
+                {
+                    unsigned int i = z * (per + 1) + x;
+                    for (unsigned int index : {i, i + per + 1, i + 1, i + 1, i + per + 1, i + per + 2})
+                        mesh.indices.push_back(index);
+                }
+            mesh.min = mesh.max = mesh.positions.front();
+            for (auto &position : mesh.positions)
+            {
+                mesh.min = glm::min(mesh.min, position);
+                mesh.max = glm::max(mesh.max, position);
+            }
+        }
+    return meshes;
+}
+
+template <typename Func>
+double measureMs(Func &&func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Model需要GL上下文(创建VAO, 上传纹理): 建一个不可见的窗口, 建不了时(没有显示)跳过Model的各项
+class BenchContext
+{
+    GLFWwindow *window_ = nullptr;
+
+public:
+    BenchContext()
+    {
+        if (!glfwInit())
+            return;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window_ = glfwCreateWindow(64, 64, "my3D_bench", nullptr, nullptr);
+        if (nullptr == window_)
+            return;
+        glfwMakeContextCurrent(window_);
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            glfwDestroyWindow(window_);
+            window_ = nullptr;
+        }
+    }
+    ~BenchContext()
+    {
+        if (nullptr != window_)
+            glfwDestroyWindow(window_);
+        glfwTerminate();
+    }
+    BenchContext(const BenchContext &) = delete;
+    BenchContext &operator=(const BenchContext &) = delete;
+    inline bool valid() const { return nullptr != window_; }
+};
+
+// 以前: Model导入一次, Animator为了读动画把文件再导入一遍; 现在动画来自Model的同一次导入, 有模型缓存时不经过assimp
+// 冷启动前删掉模型与八叉树缓存, 缓存一项读冷启动刚写下的缓存; 以前的流程按冷启动加一次动画导入计
+void benchModelLoad(const std::filesystem::path &path)
+{
+    std::cout << "\n[model load] Animator(Model(path)) cold vs cached vs re-import, " << BENCH_IMPORT_ROUNDS << " rounds" << std::endl;
+    std::size_t animationCount = 0;
+    auto load = [&]
+    {
+        Animator animator{Model(path)};
+        std::size_t vertices = 0;
+        for (auto &mesh : animator.getMeshes())
+            vertices += mesh.getVertices().size();
+        return vertices;
+    };
+    auto reimport = [&] // 以前Animator::readAnimations的工作
+    {
+        Assimp::Importer importer;
+        const aiScene *paiScene = importer.ReadFile(path, ASSIMP_IMPORT_FLAGS);
+        if (!BENCH_CHECK(paiScene != nullptr))
+            return;
+        std::vector<Animation> animations;
+        for (unsigned int i = 0; i < paiScene->mNumAnimations; ++i)
+            animations.emplace_back(paiScene->mAnimations[i]);
+        animationCount = animations.size();
+    };
+    double coldMs = 0.0, reimportMs = 0.0, cachedMs = 0.0;
+    std::size_t coldVertices = 0, cachedVertices = 0;
+    for (int r = 0; r < BENCH_IMPORT_ROUNDS; ++r)
+    {
+        std::error_code ec;
+        std::filesystem::remove(ModelCache::getPath(path), ec);
+        std::filesystem::remove(OctreeCache::getPath(path), ec);
+        coldMs += measureMs([&]
+                            { coldVertices = load(); });
+        reimportMs += measureMs(reimport);
+        cachedMs += measureMs([&]
+                              { cachedVertices = load(); });
+        BENCH_CHECK(std::filesystem::exists(ModelCache::getPath(path), ec));
+    }
+    BENCH_CHECK(coldVertices == cachedVertices);
+    double baselineMs = coldMs + reimportMs;
+    std::cout << "vertices:" << cachedVertices << " animations:" << animationCount
+              << " before:" << baselineMs / BENCH_IMPORT_ROUNDS << "ms"
+              << " cold:" << coldMs / BENCH_IMPORT_ROUNDS << "ms"
+              << " cached:" << cachedMs / BENCH_IMPORT_ROUNDS << "ms"
+              << " speedup cold:" << baselineMs / coldMs << " cached:" << baselineMs / cachedMs << std::endl;
+}
+
+// 网格的CPU部分串行(threads = 1)与并行各做一遍, 顶点, 索引与网格八叉树须完全一致
+// 两次都先删掉缓存, 否则第二次直接读第一次写下的结果
+void benchParallelMeshes(const std::filesystem::path &path)
+{
+    std::cout << "\n[mesh processing] serial vs parallel Model(path)" << std::endl;
+    struct Result
+    {
+        std::vector<std::vector<Vertex>> vertices;
+        std::vector<std::vector<GLuint>> indices;
+        std::vector<OctreeStats> stats;
+    };
+    auto load = [&](unsigned int threads, Result &result)
+    {
+        std::error_code ec;
+        std::filesystem::remove(ModelCache::getPath(path), ec);
+        std::filesystem::remove(OctreeCache::getPath(path), ec);
+        return measureMs([&]
+                         {
+                             Model model(path, Accelerator::OCTREE, threads);
+                             for (auto &mesh : model.getMeshes())
+                             {
+                                 result.vertices.push_back(mesh.getVertices());
+                                 result.indices.push_back(mesh.getIndices());
+                                 result.stats.push_back(mesh.getOctree().getStats());
+                             } });
+    };
+    Result serial, parallel;
+    double serialMs = load(1, serial);
+    double parallelMs = load(0, parallel);
+    std::size_t mismatches = 0;
+    BENCH_CHECK(serial.vertices.size() == parallel.vertices.size());
+    for (std::size_t m = 0; m < std::min(serial.vertices.size(), parallel.vertices.size()); ++m)
+    {
+        auto &a = serial.stats[m], &b = parallel.stats[m];
+        bool same = serial.vertices[m].size() == parallel.vertices[m].size() &&
+                    0 == std::memcmp(serial.vertices[m].data(), parallel.vertices[m].data(), serial.vertices[m].size() * sizeof(Vertex)) &&
+                    serial.indices[m] == parallel.indices[m] &&
+                    a.nodeCount == b.nodeCount && a.leafCount == b.leafCount && a.depth == b.depth && a.objectCount == b.objectCount &&
+                    a.nodesPerDepth == b.nodesPerDepth && a.objectsPerDepth == b.objectsPerDepth;
+        mismatches += !same;
+    }
+    BENCH_CHECK(0 == mismatches);
+    std::cout << "meshes:" << parallel.vertices.size() << " mismatches:" << mismatches
+              << " serial:" << serialMs << "ms parallel x" << std::thread::hardware_concurrency() << ":" << parallelMs << "ms"
+              << " speedup:" << serialMs / parallelMs << std::endl;
+}
+
+// 场景引用的全部纹理: 逐张串行解码 vs TextureDecoder多线程解码(不含GL上传)
+void benchTextureDecode(const std::filesystem::path &path)
+{
+    Assimp::Importer importer;
+    const aiScene *paiScene = importer.ReadFile(path, ASSIMP_IMPORT_FLAGS);
+    if (!BENCH_CHECK(paiScene != nullptr))
+        return;
+    std::vector<std::filesystem::path> paths;
+    for (unsigned int m = 0; m < paiScene->mNumMaterials; ++m)
+        for (auto type : {aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT, aiTextureType_AMBIENT})
+            for (unsigned int i = 0; i < paiScene->mMaterials[m]->GetTextureCount(type); ++i)
+            {
+                aiString texture;
+                paiScene->mMaterials[m]->GetTexture(type, i, &texture);
+                paths.push_back(path.parent_path() / texture.C_Str());
+            }
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+    std::cout << "\n[texture decode] serial vs threaded, textures:" << paths.size() << std::endl;
+    if (paths.empty())
+        return;
+    for (unsigned int threads : {0u, std::thread::hardware_concurrency()})
+    {
+        std::size_t pixels = 0;
+        double ms = measureMs([&]
+                              {
+                                  TextureDecoder decoder(paths, threads);
+                                  DecodedImage image;
+                                  while (decoder.pop(image))
+                                      pixels += static_cast<std::size_t>(image.width) * image.height; });
+        std::cout << "threads:" << threads << " pixels:" << pixels << " time:" << ms << "ms" << std::endl;
+    }
+}
+
+// 指针八叉树 vs 线性八叉树的查询吞吐
+void benchLinearOctree(std::vector<BenchMesh> &meshes)
+{
+    std::cout << "\n[octree query] pointer vs linear, " << BENCH_QUERY_COUNT << " queries/mesh" << std::endl;
+    for (auto &mesh : meshes)
+    {
+        TriangleOctree pointerTree = buildOctree(mesh);
+        TriangleOctree linearTree = buildOctree(mesh);
+        linearTree.linearize();
+        auto queries = makeQueries(mesh, BENCH_QUERY_COUNT);
+        std::size_t pointerHits = 0, linearHits = 0;
+        double pointerMs = measureMs([&]
+                                     { for (auto &q : queries) pointerTree.query(q, [&](std::uint32_t) { ++pointerHits; }); });
+        double linearMs = measureMs([&]
+                                    { for (auto &q : queries) linearTree.query(q, [&](std::uint32_t) { ++linearHits; }); });
+        BENCH_CHECK(pointerHits == linearHits);
+        std::cout << "triangles:" << mesh.indices.size() / 3
+                  << " hits:" << pointerHits
+                  << " pointer:" << BENCH_QUERY_COUNT / pointerMs * 1e3 << "q/s"
+                  << " linear:" << BENCH_QUERY_COUNT / linearMs * 1e3 << "q/s"
+                  << " speedup:" << pointerMs / linearMs << std::endl;
+    }
+}
+
+// 两级查询(模型八叉树筛网格, 再查网格八叉树) vs 覆盖所有网格三角形的场景索引(Model::buildSceneIndex)
+void benchSceneIndex(std::vector<BenchMesh> &meshes)
+{
+    std::cout << "\n[scene index] two-level vs scene bvh, " << meshes.size() << " meshes, "
+              << BENCH_QUERY_COUNT << " queries" << std::endl;
+    if (meshes.empty())
+        return;
+    BenchMesh scene;
+    scene.min = meshes[0].min;
+    scene.max = meshes[0].max;
+    std::vector<TriangleOctree> octrees;
+    std::vector<Bounds> triangles;
+    std::vector<MeshTriangle> payloads;
+    for (std::size_t m = 0; m < meshes.size(); ++m)
+    {
+        scene.min = glm::min(scene.min, meshes[m].min);
+        scene.max = glm::max(scene.max, meshes[m].max);
+        octrees.emplace_back(Bounds(meshes[m].min, meshes[m].max));
+        octrees.back().bulkBuild(triangleBounds(meshes[m]), trianglePayloads(meshes[m]));
+        auto meshTriangles = triangleBounds(meshes[m]);
+        for (std::size_t i = 0; i < meshTriangles.size(); ++i)
+        {
+            triangles.push_back(meshTriangles[i]);
+            payloads.push_back(MeshTriangle{static_cast<std::uint32_t>(m), static_cast<std::uint32_t>(i)});
+        }
+    }
+    Octree model(Bounds(scene.min, scene.max), OctreeParams::fromCount(meshes.size()));
+    for (auto &octree : octrees)
+        model.insert(octree.getGlobalAABB(), &octree);
+    model.linearize();
+    std::size_t triangleCount = triangles.size();
+    SceneBVH sceneIndex;
+    double sceneBuildMs = measureMs([&]
+                                    { sceneIndex = SceneBVH(std::move(triangles), std::move(payloads)); });
+    auto queries = makeQueries(scene, BENCH_QUERY_COUNT);
+    std::size_t twoLevelHits = 0, sceneHits = 0;
+    double twoLevelMs = measureMs([&]
+                                  {
+        for (auto &q : queries)
+            model.query(q, [&](void *where)
+                        { static_cast<const TriangleOctree *>(where)->query(q, [&](std::uint32_t)
+                                                                              { ++twoLevelHits; }); }); });
+    double sceneMs = measureMs([&]
+                               { for (auto &q : queries) sceneIndex.query(q, [&](MeshTriangle) { ++sceneHits; }); });
+    BENCH_CHECK(twoLevelHits == sceneHits);
+    std::cout << "triangles:" << triangleCount << " hits:" << sceneHits << " scene build:" << sceneBuildMs << "ms"
+              << " two-level:" << twoLevelMs * 1e6 / BENCH_QUERY_COUNT << "ns"
+              << " scene:" << sceneMs * 1e6 / BENCH_QUERY_COUNT << "ns"
+              << " speedup:" << twoLevelMs / sceneMs << std::endl;
+}
+
+// 逐个insert的指针树: 构建与析构的耗时, 以及构建期间的堆分配次数
+void benchPointerTree(std::vector<BenchMesh> &meshes)
+{
+    std::cout << "\n[pointer tree] incremental build + teardown" << std::endl;
+    for (auto &mesh : meshes)
+    {
+        auto triangles = triangleBounds(mesh);
+        std::optional<TriangleOctree> octree;
+        std::size_t allocs = allocationCount;
+        double buildMs = measureMs([&]
+                                   {
+            octree.emplace(Bounds(mesh.min, mesh.max), OctreeParams::fromCount(triangles.size()));
+            for (std::size_t i = 0; i < triangles.size(); ++i)
+                octree->insert(triangles[i], static_cast<std::uint32_t>(i)); });
+        allocs = allocationCount - allocs;
+        double teardownMs = measureMs([&]
+                                      { octree.reset(); });
+        std::cout << "triangles:" << triangles.size()
+                  << " build:" << buildMs << "ms/" << allocs << "allocs"
+                  << " teardown:" << teardownMs << "ms" << std::endl;
+    }
+}
+
+// 线性八叉树 vs SAH BVH的构建时间与查询代价
+void benchBVH(std::vector<BenchMesh> &meshes)
+{
+    std::cout << "\n[octree vs bvh] build + " << BENCH_QUERY_COUNT << " queries/mesh" << std::endl;
+    for (auto &mesh : meshes)
+    {
+        TriangleOctree octree;
+        TriangleBVH bvh;
+        double octreeBuildMs = measureMs([&]
+                                         { octree = buildOctree(mesh); octree.linearize(); });
+        double bvhBuildMs = measureMs([&]
+                                      { bvh = TriangleBVH(triangleBounds(mesh), trianglePayloads(mesh)); });
+        auto queries = makeQueries(mesh, BENCH_QUERY_COUNT);
+        std::size_t octreeHits = 0, bvhHits = 0;
+        double octreeMs = measureMs([&]
+                                    { for (auto &q : queries) octree.query(q, [&](std::uint32_t) { ++octreeHits; }); });
+        double bvhMs = measureMs([&]
+                                 { for (auto &q : queries) bvh.query(q, [&](std::uint32_t) { ++bvhHits; }); });
+        BENCH_CHECK(octreeHits == bvhHits);
+        std::cout << "triangles:" << mesh.indices.size() / 3
+                  << " build octree:" << octreeBuildMs << "ms bvh:" << bvhBuildMs << "ms"
+                  << " query octree:" << octreeMs * 1e6 / BENCH_QUERY_COUNT << "ns"
+                  << " bvh:" << bvhMs * 1e6 / BENCH_QUERY_COUNT << "ns" << std::endl;
+    }
+}
+
+// 逐个insert再linearize vs Morton码批量构建
+void benchBulkBuild(std::vector<BenchMesh> &meshes)
+{
+    std::cout << "\n[octree build] incremental vs bulk" << std::endl;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    for (auto &mesh : meshes)
+    {
+        auto triangles = triangleBounds(mesh);
+        auto payloads = trianglePayloads(mesh);
+        TriangleOctree incremental, bulk, parallel;
+        double incrementalMs = measureMs([&]
+                                         { incremental = buildOctree(mesh); incremental.linearize(); });
+        double bulkMs = measureMs([&]
+                                  { bulk = TriangleOctree(Bounds(mesh.min, mesh.max)); bulk.bulkBuild(triangles, payloads); });
+        double parallelMs = measureMs([&]
+                                      { parallel = TriangleOctree(Bounds(mesh.min, mesh.max)); parallel.bulkBuild(triangles, payloads, threads); });
+        auto queries = makeQueries(mesh, BENCH_QUERY_COUNT / 10);
+        std::size_t incrementalHits = 0, bulkHits = 0;
+        for (auto &q : queries)
+        {
+            incremental.query(q, [&](std::uint32_t)
+                              { ++incrementalHits; });
+            parallel.query(q, [&](std::uint32_t)
+                           { ++bulkHits; });
+        }
+        BENCH_CHECK(incrementalHits == bulkHits);
+        // 同一棵树换成指针载荷时的内存
+        Octree pointers(Bounds(mesh.min, mesh.max));
+        pointers.bulkBuild(triangles, trianglePointers(mesh));
+        std::cout << "triangles:" << triangles.size()
+                  << " incremental:" << incrementalMs << "ms"
+                  << " bulk:" << bulkMs << "ms"
+                  << " bulk x" << threads << ":" << parallelMs << "ms"
+                  << " speedup:" << incrementalMs / parallelMs
+                  << " memory index:" << bulk.getStats().memoryBytes << "B pointer:" << pointers.getStats().memoryBytes << "B" << std::endl;
+    }
+}
+
+// 完全平的网格(y方向厚度为0): 批量构建的Morton码不能因除以0而错乱, 树形与查询结果须与逐个insert一致
+void checkFlatMesh()
+{
+    auto mesh = makeTerrain(20000, 1, 0.0f).front();
+    BENCH_CHECK(mesh.min.y == mesh.max.y);
+    TriangleOctree incremental = buildOctree(mesh);
+    incremental.linearize();
+    TriangleOctree bulk(Bounds(mesh.min, mesh.max));
+    bulk.bulkBuild(triangleBounds(mesh), trianglePayloads(mesh));
+    std::size_t incrementalHits = 0, bulkHits = 0;
+    for (auto &q : makeQueries(mesh, BENCH_QUERY_COUNT / 100))
+    {
+        incremental.query(q, [&](std::uint32_t)
+                          { ++incrementalHits; });
+        bulk.query(q, [&](std::uint32_t)
+                   { ++bulkHits; });
+    }
+    auto incrementalStats = incremental.getStats(), bulkStats = bulk.getStats();
+    BENCH_CHECK(incrementalHits == bulkHits);
+    BENCH_CHECK(incrementalStats.nodeCount == bulkStats.nodeCount &&
+                incrementalStats.objectsPerDepth == bulkStats.objectsPerDepth);
+    std::cout << "\n[flat mesh] triangles:" << mesh.indices.size() / 3 << " nodes:" << bulkStats.nodeCount
+              << " depth:" << bulkStats.depth << " leaf objects:" << bulkStats.leafObjects << " hits:" << bulkHits << std::endl;
+}
+
+// 没有网格的模型(骨架, 只有动画的文件): Model::finishLoad不建树, linearize()对没建的树什么都不做
+void checkEmptyModel()
+{
+    std::vector<BenchMesh> meshes;
+    Octree octree;
+    for (auto &mesh : meshes)
+        octree.insert(Bounds(mesh.min, mesh.max), &mesh);
+    octree.linearize();
+    BENCH_CHECK(!octree.isBuilt() && !octree.isLinear());
+    benchSceneIndex(meshes);
+    std::cout << "\n[empty model] meshes:0 built:" << octree.isBuilt() << std::endl;
+}
+
+// 导入失败时Model::prepare抛出, 经ModelLoader加载的future在get()时转交; 失败发生在工作线程上, 不需要GL上下文
+void checkMissingModel()
+{
+    auto path = std::filesystem::temp_directory_path() / "my3d_bench_missing.fbx";
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    ModelLoader loader;
+    auto future = loader.load(path);
+    while (loader.update() > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::string error;
+    bool thrown = false;
+    try
+    {
+        future.get();
+    }
+    catch (const std::runtime_error &e)
+    {
+        thrown = true;
+        error = e.what();
+    }
+    BENCH_CHECK(thrown);
+    std::cout << "\n[missing model] thrown:" << thrown << " error:" << error << std::endl;
+}
+
+// 最近命中: 逐个三角形暴力求交 vs 八叉树/BVH射线查询
+void benchRaycast(std::vector<BenchMesh> &meshes)
+{
+    std::cout << "\n[raycast] brute force vs octree vs bvh, " << BENCH_RAY_COUNT << " rays/mesh" << std::endl;
+    for (auto &mesh : meshes)
+    {
+        TriangleOctree octree(Bounds(mesh.min, mesh.max));
+        octree.bulkBuild(triangleBounds(mesh), trianglePayloads(mesh));
+        TriangleBVH bvh(triangleBounds(mesh), trianglePayloads(mesh));
+        // 从包围盒上方随机点向下(略带倾斜)发射, 模拟地面探测
+        std::mt19937 rng(20240602);
+        std::uniform_real_distribution<float> dx(mesh.min.x, mesh.max.x);
+        std::uniform_real_distribution<float> dz(mesh.min.z, mesh.max.z);
+        std::uniform_real_distribution<float> tilt(-0.2f, 0.2f);
+        std::vector<Ray> rays;
+        for (int i = 0; i < BENCH_RAY_COUNT; ++i)
+            rays.emplace_back(glm::vec3(dx(rng), mesh.max.y + 1.0f, dz(rng)), glm::vec3(tilt(rng), -1.0f, tilt(rng)));
+        float limit = glm::length(mesh.max - mesh.min) + 2.0f;
+        auto intersect = [&](const Ray &ray, const unsigned int *triangle, float &distance)
+        {
+            glm::vec2 barycentric;
+            return glm::intersectRayTriangle(ray.origin, ray.direction,
+                                             mesh.positions[triangle[0]],
+                                             mesh.positions[triangle[1]],
+                                             mesh.positions[triangle[2]],
+                                             barycentric, distance) &&
+                   distance >= 0.0f;
+        };
+        std::vector<float> bruteHits(rays.size(), limit), octreeHits(rays.size(), limit), bvhHits(rays.size(), limit);
+        double bruteMs = measureMs([&]
+                                   {
+            for (std::size_t r = 0; r < rays.size(); ++r)
+                for (std::size_t i = 0; i < mesh.indices.size(); i += 3)
+                {
+                    float distance;
+                    if (intersect(rays[r], &mesh.indices[i], distance))
+                        bruteHits[r] = std::min(bruteHits[r], distance);
+                } });
+        auto closest = [&](const auto &tree, std::vector<float> &hits)
+        {
+            return measureMs([&]
+                             {
+                for (std::size_t r = 0; r < rays.size(); ++r)
+                    tree.raycast(rays[r], limit, [&](std::uint32_t where, float &tMax)
+                                 {
+                                     float distance;
+                                     if (intersect(rays[r], &mesh.indices[3 * static_cast<std::size_t>(where)], distance) && distance <= tMax)
+                                         hits[r] = tMax = distance;
+                                     return false; }); });
+        };
+        double octreeMs = closest(octree, octreeHits);
+        double bvhMs = closest(bvh, bvhHits);
+        BENCH_CHECK(bruteHits == octreeHits && bruteHits == bvhHits);
+        std::cout << "triangles:" << mesh.indices.size() / 3
+                  << " brute:" << bruteMs * 1e6 / BENCH_RAY_COUNT << "ns"
+                  << " octree:" << octreeMs * 1e6 / BENCH_RAY_COUNT << "ns"
+                  << " bvh:" << bvhMs * 1e6 / BENCH_RAY_COUNT << "ns"
+                  << " speedup:" << bruteMs / octreeMs << std::endl;
+    }
+}
+
+// 最近点: 逐个三角形暴力求距离 vs 八叉树/BVH分支限界, 以及k近邻
+void benchClosestPoint(std::vector<BenchMesh> &meshes)
+{
+    std::cout << "\n[closest point] brute force vs octree vs bvh, " << BENCH_POINT_COUNT << " points/mesh, k="
+              << BENCH_NEAREST_K << std::endl;
+    for (auto &mesh : meshes)
+    {
+        TriangleOctree octree(Bounds(mesh.min, mesh.max));
+        octree.bulkBuild(triangleBounds(mesh), trianglePayloads(mesh));
+        TriangleBVH bvh(triangleBounds(mesh), trianglePayloads(mesh));
+        // 包围盒外扩一圈内的随机点, 模拟穿透修正时的球心
+        std::mt19937 rng(20240603);
+        glm::vec3 margin = (mesh.max - mesh.min) * 0.1f + glm::vec3(0.1f);
+        std::uniform_real_distribution<float> dx(mesh.min.x - margin.x, mesh.max.x + margin.x);
+        std::uniform_real_distribution<float> dy(mesh.min.y - margin.y, mesh.max.y + margin.y);
+        std::uniform_real_distribution<float> dz(mesh.min.z - margin.z, mesh.max.z + margin.z);
+        std::vector<glm::vec3> points;
+        for (int i = 0; i < BENCH_POINT_COUNT; ++i)
+            points.emplace_back(dx(rng), dy(rng), dz(rng));
+        float limit2 = glm::dot(mesh.max - mesh.min + margin * 2.0f, mesh.max - mesh.min + margin * 2.0f);
+        auto distance2 = [&](const glm::vec3 &point, const unsigned int *triangle)
+        {
+            glm::vec2 barycentric;
+            glm::vec3 offset = closestPointOnTriangle(point,
+                                                      mesh.positions[triangle[0]],
+                                                      mesh.positions[triangle[1]],
+                                                      mesh.positions[triangle[2]],
+                                                      barycentric) -
+                               point;
+            return glm::dot(offset, offset);
+        };
+        std::vector<float> bruteHits(points.size(), limit2), octreeHits(points.size(), limit2), bvhHits(points.size(), limit2);
+        double bruteMs = measureMs([&]
+                                   {
+            for (std::size_t p = 0; p < points.size(); ++p)
+                for (std::size_t i = 0; i < mesh.indices.size(); i += 3)
+                    bruteHits[p] = std::min(bruteHits[p], distance2(points[p], &mesh.indices[i])); });
+        auto closest = [&](const auto &tree, std::vector<float> &hits)
+        {
+            return measureMs([&]
+                             {
+                for (std::size_t p = 0; p < points.size(); ++p)
+                    tree.nearest(points[p], limit2, [&](std::uint32_t where, float &maxDistance2)
+                                 {
+                                     float d2 = distance2(points[p], &mesh.indices[3 * static_cast<std::size_t>(where)]);
+                                     if (d2 <= maxDistance2)
+                                         hits[p] = maxDistance2 = d2; }); });
+        };
+        double octreeMs = closest(octree, octreeHits);
+        double bvhMs = closest(bvh, bvhHits);
+        BENCH_CHECK(bruteHits == octreeHits && bruteHits == bvhHits);
+        // k近邻: visitor维护升序的k个距离, 满k后以第k个剪枝
+        std::vector<float> best;
+        std::size_t knnMismatch = 0;
+        double knnMs = measureMs([&]
+                                 {
+            for (std::size_t p = 0; p < points.size(); ++p)
+            {
+                best.clear();
+                octree.nearest(points[p], limit2, [&](std::uint32_t where, float &maxDistance2)
+                               {
+                                   float d2 = distance2(points[p], &mesh.indices[3 * static_cast<std::size_t>(where)]);
+                                   best.insert(std::upper_bound(best.begin(), best.end(), d2), d2);
+                                   if (best.size() > BENCH_NEAREST_K)
+                                       best.pop_back();
+                                   if (best.size() == BENCH_NEAREST_K)
+                                       maxDistance2 = best.back(); });
+                knnMismatch += best.empty() || best.front() != bruteHits[p];
+            } });
+        BENCH_CHECK(0 == knnMismatch);
+        std::cout << "triangles:" << mesh.indices.size() / 3
+                  << " brute:" << bruteMs * 1e6 / BENCH_POINT_COUNT << "ns"
+                  << " octree:" << octreeMs * 1e6 / BENCH_POINT_COUNT << "ns"
+                  << " bvh:" << bvhMs * 1e6 / BENCH_POINT_COUNT << "ns"
+                  << " knn:" << knnMs * 1e6 / BENCH_POINT_COUNT << "ns"
+                  << " speedup:" << bruteMs / octreeMs << std::endl;
+    }
+}
+
+// 快速移动的球: 扫掠盒查询 vs 胶囊体查询交给窄相的三角形数与耗时
+void benchSweptSphere(std::vector<BenchMesh> &meshes)
+{
+    std::cout << "\n[swept sphere] box vs capsule, " << BENCH_QUERY_COUNT / 10 << " queries/mesh" << std::endl;
+    for (auto &mesh : meshes)
+    {
+        TriangleOctree octree(Bounds(mesh.min, mesh.max));
+        octree.bulkBuild(triangleBounds(mesh), trianglePayloads(mesh));
+        std::mt19937 rng(20240603);
+        std::uniform_real_distribution<float> step(-2.0f, 2.0f);
+        std::vector<Capsule> capsules;
+        for (auto &q : makeQueries(mesh, BENCH_QUERY_COUNT / 10))
+        {
+            glm::vec3 a = q.centre();
+            capsules.emplace_back(a, a + glm::vec3(step(rng), step(rng), step(rng)), BENCH_QUERY_EXTENT);
+        }
+        std::size_t boxHits = 0, capsuleHits = 0;
+        double boxMs = measureMs([&]
+                                 { for (auto &c : capsules) octree.query(c.getBounds(), [&](std::uint32_t) { ++boxHits; }); });
+        double capsuleMs = measureMs([&]
+                                     { for (auto &c : capsules) octree.query(c, [&](std::uint32_t) { ++capsuleHits; }); });
+        std::cout << "triangles:" << mesh.indices.size() / 3
+                  << " candidates box:" << boxHits << " capsule:" << capsuleHits
+                  << " time box:" << boxMs << "ms capsule:" << capsuleMs << "ms" << std::endl;
+    }
+}
+
+// 返回vector的查询 vs visitor/调用者缓冲区查询, 同时统计堆分配次数
+void benchVisitorQuery(std::vector<BenchMesh> &meshes)
+{
+    std::cout << "\n[query api] copy vs visitor vs buffer, " << BENCH_QUERY_COUNT << " queries/mesh" << std::endl;
+    for (auto &mesh : meshes)
+    {
+        // 返回AABB的拷贝查询只有指针载荷才有
+        Octree octree(Bounds(mesh.min, mesh.max));
+        octree.bulkBuild(triangleBounds(mesh), trianglePointers(mesh));
+        auto queries = makeQueries(mesh, BENCH_QUERY_COUNT);
+        std::vector<void *> buffer;
+        buffer.reserve(mesh.indices.size() / 3);
+        std::size_t copyHits = 0, visitorHits = 0, bufferHits = 0;
+        std::size_t copyAllocs = allocationCount;
+        double copyMs = measureMs([&]
+                                  { for (auto &q : queries) copyHits += octree.query(q).size(); });
+        copyAllocs = allocationCount - copyAllocs;
+        std::size_t visitorAllocs = allocationCount;
+        double visitorMs = measureMs([&]
+                                     { for (auto &q : queries) octree.query(q, [&](void *) { ++visitorHits; }); });
+        visitorAllocs = allocationCount - visitorAllocs;
+        std::size_t bufferAllocs = allocationCount;
+        double bufferMs = measureMs([&]
+                                    { for (auto &q : queries)
+                                      {
+                                          buffer.clear();
+                                          octree.query(q, buffer);
+                                          bufferHits += buffer.size();
+                                      } });
+        bufferAllocs = allocationCount - bufferAllocs;
+        BENCH_CHECK(copyHits == visitorHits && copyHits == bufferHits);
+        BENCH_CHECK(visitorAllocs == 0 && bufferAllocs == 0);
+        std::cout << "triangles:" << mesh.indices.size() / 3
+                  << " copy:" << copyMs * 1e6 / BENCH_QUERY_COUNT << "ns/" << copyAllocs << "allocs"
+                  << " visitor:" << visitorMs * 1e6 / BENCH_QUERY_COUNT << "ns/" << visitorAllocs << "allocs"
+                  << " buffer:" << bufferMs * 1e6 / BENCH_QUERY_COUNT << "ns/" << bufferAllocs << "allocs" << std::endl;
+    }
+}
+
+// 批量相交内核的吞吐: 标量 vs SIMD(按编译选项选择SSE/AVX2)
+#define BENCH_KERNEL_BOXES 4096
+#define BENCH_KERNEL_ROUNDS 2000
+// Ground::update每帧对所有碰撞体的扫掠盒做一次批量查询, 这里比较批量与逐个查询
+void benchBatchQuery(std::vector<BenchMesh> &meshes)
+{
+    std::cout << "\n[batch query] one traversal for N ranges vs N single queries" << std::endl;
+    for (auto &mesh : meshes)
+    {
+        TriangleOctree octree = buildOctree(mesh);
+        octree.linearize();
+        for (int n : BENCH_BATCH_SIZES)
+        {
+            auto queries = makeQueries(mesh, n);
+            int rounds = std::max(1, BENCH_QUERY_COUNT / n);
+            std::vector<std::vector<std::uint32_t>> results;
+            std::vector<std::uint32_t> buffer;
+            std::size_t singleHits = 0, batchHits = 0;
+            double singleMs = measureMs([&]
+                                        { for (int k = 0; k < rounds; ++k)
+                                              for (auto &q : queries)
+                                              {
+                                                  buffer.clear();
+                                                  octree.query(q, buffer);
+                                                  singleHits += buffer.size();
+                                              } });
+            double batchMs = measureMs([&]
+                                       { for (int k = 0; k < rounds; ++k)
+                                         {
+                                             for (auto &hits : results)
+                                                 hits.clear();
+                                             octree.query(queries, results);
+                                             for (auto &hits : results)
+                                                 batchHits += hits.size();
+                                         } });
+            BENCH_CHECK(singleHits == batchHits);
+            std::cout << "triangles:" << mesh.indices.size() / 3 << " ranges:" << n
+                      << " single:" << singleMs * 1e6 / (rounds * n) << "ns/range"
+                      << " batch:" << batchMs * 1e6 / (rounds * n) << "ns/range"
+                      << " speedup:" << singleMs / batchMs << "x" << std::endl;
+        }
+    }
+}
+void benchOverlapKernel()
+{
+    std::mt19937 rng(20240601);
+    std::uniform_real_distribution<float> d(0.0f, 100.0f);
+    BoundsSoA soa;
+    for (int i = 0; i < BENCH_KERNEL_BOXES; ++i)
+    {
+        glm::vec3 min(d(rng), d(rng), d(rng));
+        soa.push_back(Bounds(min, min + glm::vec3(1.0f)));
+    }
+    Bounds range(glm::vec3(40.0f), glm::vec3(60.0f));
+    unsigned int scalarHits = 0, simdHits = 0;
+    double scalarMs = measureMs([&]
+                                { for (int r = 0; r < BENCH_KERNEL_ROUNDS; ++r)
+                                      for (std::size_t i = 0; i < soa.size(); i += 8)
+                                          scalarHits += std::popcount(Overlap::test8Scalar(soa, i, range)); });
+    double simdMs = measureMs([&]
+                              { for (int r = 0; r < BENCH_KERNEL_ROUNDS; ++r)
+                                    for (std::size_t i = 0; i < soa.size(); i += 8)
+                                        simdHits += std::popcount(Overlap::test8(soa, i, range)); });
+    BENCH_CHECK(scalarHits == simdHits);
+    double boxes = static_cast<double>(BENCH_KERNEL_BOXES) * BENCH_KERNEL_ROUNDS;
+#if defined(__AVX2__)
+    const char *isa = "avx2";
+#elif defined(__SSE2__)
+    const char *isa = "sse";
+#else
+    const char *isa = "scalar";
+#endif
+    std::cout << "\n[overlap kernel] " << isa
+              << " scalar:" << boxes / scalarMs * 1e-3 << "Mboxes/s"
+              << " simd:" << boxes / simdMs * 1e-3 << "Mboxes/s"
+              << " speedup:" << scalarMs / simdMs << std::endl;
+}
+
+// 查询负载文件: 每行一个查询盒"minX minY minZ maxX maxY maxZ"(模型空间)
+std::vector<Bounds> loadWorkload(const std::filesystem::path &path)
+{
+    std::vector<Bounds> queries;
+    std::ifstream in(path);
+    Bounds q;
+    while (in >> q.min.x >> q.min.y >> q.min.z >> q.max.x >> q.max.y >> q.max.z)
+        queries.push_back(q);
+    return queries;
+}
+
+// 对整个模型扫描(深度, 叶子容量), 以构建后全部网格回答负载的总时间为准选最优, 写入资源旁的cfg
+void benchTune(std::vector<BenchMesh> &meshes, const std::filesystem::path &path, const std::vector<Bounds> &workload)
+{
+    std::cout << "\n[octree tune] " << (workload.empty() ? "synthetic" : "recorded") << " workload" << std::endl;
+    std::vector<std::vector<Bounds>> queries;
+    for (auto &mesh : meshes)
+        queries.push_back(workload.empty() ? makeQueries(mesh, BENCH_QUERY_COUNT / 10) : workload);
+    OctreeParams best;
+    double bestMs = -1.0;
+    for (int maxDepth = 1; maxDepth <= BENCH_TUNE_MAX_DEPTH; ++maxDepth)
+        for (int maxObjects = 1; maxObjects <= BENCH_TUNE_MAX_OBJECTS; maxObjects *= 2)
+        {
+            OctreeParams params{maxDepth, maxObjects};
+            std::vector<TriangleOctree> octrees;
+            for (auto &mesh : meshes)
+            {
+                octrees.emplace_back(Bounds(mesh.min, mesh.max), params);
+                octrees.back().bulkBuild(triangleBounds(mesh), trianglePayloads(mesh));
+            }
+            std::size_t hits = 0;
+            double ms = measureMs([&]
+                                  {
+                for (std::size_t m = 0; m < octrees.size(); ++m)
+                    for (auto &q : queries[m])
+                        octrees[m].query(q, [&](std::uint32_t)
+                                         { ++hits; }); });
+            std::cout << "depth:" << maxDepth << " leaf:" << maxObjects
+                      << " hits:" << hits << " " << ms << "ms" << std::endl;
+            if (bestMs < 0.0 || ms < bestMs)
+            {
+                bestMs = ms;
+                best = params;
+            }
+        }
+    std::cout << "best depth:" << best.maxDepth << " leaf:" << best.maxObjects << " " << bestMs << "ms";
+    if (std::filesystem::exists(path) && OctreeCache::saveParams(path, best)) // 合成地形没有资源文件, 不写cfg
+        std::cout << " -> " << path.string() << OCTREE_PARAMS_EXTENSION;
+    std::cout << std::endl;
+}
+
+// 按Model的方式(cfg参数或按三角形数估算)构建每个网格的八叉树, 逐网格输出统计
+void dumpStats(std::vector<BenchMesh> &meshes, const std::filesystem::path &path,
+               const std::vector<Bounds> &workload, bool json)
+{
+    OctreeCache cache(path);
+    if (json)
+        std::cout << "[";
+    for (std::size_t m = 0; m < meshes.size(); ++m)
+    {
+        auto &mesh = meshes[m];
+        TriangleOctree octree(Bounds(mesh.min, mesh.max), cache.getParams(mesh.indices.size() / 3));
+        octree.bulkBuild(triangleBounds(mesh), trianglePayloads(mesh));
+        auto stats = octree.getStats(workload.empty() ? makeQueries(mesh, BENCH_QUERY_COUNT / 100) : workload);
+        std::string name = path.filename().string() + "#" + std::to_string(m);
+        if (json)
+        {
+            std::cout << (m == 0 ? "\n" : ",\n");
+            stats.writeJSON(std::cout, name);
+        }
+        else
+            stats.writeCSV(std::cout, name, m == 0);
+    }
+    if (json)
+        std::cout << "\n]" << std::endl;
+}
+
+// my3D_bench [--tune | --stats [--json]] [--workload 查询文件] [--synthetic 三角形数] [模型路径]
+// --synthetic不读模型, 用makeTerrain生成的起伏地形(单个网格), 跳过导入与纹理两项; 场景索引一项另按1/4/16/64个网格切分
+int main(int argc, char **argv)
+{
+    std::filesystem::path path = std::filesystem::current_path() / "../resources/terrains/boxes/boxes.fbx";
+    std::filesystem::path workloadPath;
+    std::size_t synthetic = 0;
+    bool tune = false, stats = false, json = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if ("--tune" == arg)
+            tune = true;
+        else if ("--stats" == arg)
+            stats = true;
+        else if ("--json" == arg)
+            json = true;
+        else if ("--workload" == arg && i + 1 < argc)
+            workloadPath = argv[++i];
+        else if ("--synthetic" == arg && i + 1 < argc)
+            synthetic = std::stoul(argv[++i]);
+        else
+            path = arg;
+    }
+    if (synthetic > 0)
+        path = "synthetic" + std::to_string(synthetic);
+    auto meshes = synthetic > 0 ? makeTerrain(synthetic, 1, BENCH_TERRAIN_AMPLITUDE) : loadMeshes(path);
+    auto workload = workloadPath.empty() ? std::vector<Bounds>() : loadWorkload(workloadPath);
+    if (stats)
+    {
+        dumpStats(meshes, path, workload, json); // 只输出统计, 方便重定向成文件
+        return 0;
+    }
+    std::cout << path << " meshes:" << meshes.size() << std::endl;
+    if (tune)
+    {
+        benchTune(meshes, path, workload);
+        return 0;
+    }
+    if (0 == synthetic)
+    {
+        BenchContext context;
+        if (context.valid())
+        {
+            benchModelLoad(path);
+            benchParallelMeshes(path);
+        }
+        else
+            std::cout << "\n[model load] skipped, no GL context" << std::endl;
+        benchTextureDecode(path);
+    }
+    benchLinearOctree(meshes);
+    benchPointerTree(meshes);
+    benchBVH(meshes);
+    benchBulkBuild(meshes);
+    checkFlatMesh();
+    checkEmptyModel();
+    checkMissingModel();
+    benchRaycast(meshes);
+    benchClosestPoint(meshes);
+    benchSweptSphere(meshes);
+    benchVisitorQuery(meshes);
+    benchBatchQuery(meshes);
+    if (synthetic > 0)
+        for (int tiles : BENCH_TERRAIN_TILES) // 同一块地形切成不同数量的网格
+        {
+            auto split = makeTerrain(synthetic, tiles, BENCH_TERRAIN_AMPLITUDE);
+            benchSceneIndex(split);
+        }
+    else
+        benchSceneIndex(meshes);
+    benchOverlapKernel();
+    if (checkFailures > 0)
+        std::cerr << checkFailures << " checks failed" << std::endl;
+    return checkFailures > 0 ? 1 : 0;
+}
@@ -4,6 +4,7 @@
 #define ENGINE_GL
 #include "engine_gl.hpp"
 #include "ground.hpp"
+#include "model_loader.hpp"
 
 #include "logger.hpp"
 
@@ -24,20 +25,34 @@ int main()
                      std::filesystem::current_path() / "../opengl/glsl/anim_gs");
     Ground ground(Animator(Model(std::filesystem::current_path() / "../resources/terrains/boxes/boxes.fbx")));
     Engine::interactor = &ground;
-    ground.addCollider("sphere",
-                   Collider(Animator(Model(std::filesystem::current_path() / "../resources/objects/sphere/sphere.fbx"))));
+    // ground.recordWorkload("boxes.workload"); // 之后可用my3D_bench --tune --workload boxes.workload调参
+    // 球体在后台加载, 就绪前照常渲染地面
+    ModelLoader loader;
+    auto sphereModel = loader.load(std::filesystem::current_path() / "../resources/objects/sphere/sphere.fbx");
+    Collider *sphere = nullptr;
     // ground.addCollider("cube",
     //                Collider(Animator(Model(std::filesystem::current_path() / "../resources/objects/cube/cube.fbx"))));
     // engine.addDeliver("spin", ground.getCollider("cube").myTransforms());
-    auto &sphere = ground.getCollider("sphere");
+    TextureRegistry::get().getStats().print(std::clog);
     // auto &cube = ground.getCollider("cube");
     while (engine.isRunning())
     {
         engine.update();
         ////////////////////////////////////////
         engine.draw("static", ground);
-        sphere.setView(engine.getGlobalMat());
-        engine.draw("static", sphere, sphere.getGlobalMat());
+        if (nullptr == sphere && 0 == loader.update())
+        {
+            Collider collider(Animator(sphereModel.get()));
+            float radius = collider.getOctree().getGlobalAABB().size().x * 0.5f;
+            ground.addCollider("sphere", Collider_sphere(std::move(collider), radius));
+            sphere = &ground.getCollider("sphere");
+            TextureRegistry::get().getStats().print(std::clog);
+        }
+        if (nullptr != sphere)
+        {
+            sphere->setView(engine.getGlobalMat());
+            engine.draw("static", *sphere, sphere->getGlobalMat());
+        }
         // cube.updateTransforms(Engine::deltaTime);
         // engine.draw("dynamic", "spin", cube);
         ////////////////////////////////////////
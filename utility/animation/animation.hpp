@@ -25,6 +25,14 @@ public:
             keyFrames_.emplace(curBone->mNodeName.C_Str(), KeyFrame(curBone));
         }
     }
+    // 从模型缓存恢复
+    Animation(double duration, double ticksPerSecond, std::unordered_map<std::string, KeyFrame> &&keyFrames)
+        : duration_(duration),
+          ticksPerSecond_(ticksPerSecond),
+          keyFrames_(std::move(keyFrames))
+    {
+        assert(ticksPerSecond_ != 0);
+    }
     ~Animation()
     {
         keyFrames_.clear();
@@ -46,6 +54,7 @@ public:
         return *this;
     }
     inline std::unordered_map<std::string, KeyFrame> &getKeyFrames() { return keyFrames_; }
+    inline const std::unordered_map<std::string, KeyFrame> &getKeyFrames() const { return keyFrames_; }
     inline double getTicksPerSecond() const { return ticksPerSecond_; }
     inline double getDuration() const { return duration_; }
 
@@ -18,14 +18,14 @@ public:
     Animator(Model &&model)
         : Model(std::move(model))
     {
-        readAnimations(getPath());
+        readAnimations();
     }
     Animator(Model &&model,
              const std::string &animName,
              GLuint nextBindingPoint)
         : Model(std::move(model))
     {
-        readAnimations(getPath());
+        readAnimations();
         setCurAnimation(animName);
     }
     ~Animator()
@@ -84,31 +84,22 @@ public:
     }
 
 private:
-    void readAnimations(const std::filesystem::path &path)
+    // 取走Model导入时一并读出的动画
+    void readAnimations()
     {
-        Assimp::Importer importer;
-        auto paiScene = importer.ReadFile(path,
-                                          aiProcess_CalcTangentSpace |
-                                              aiProcess_Triangulate |
-                                              aiProcess_GenSmoothNormals |
-                                              aiProcess_LimitBoneWeights |
-                                              aiProcess_JoinIdenticalVertices |
-                                              aiProcess_ConvertToLeftHanded);
-        assert(paiScene != nullptr &&
-               !(paiScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) &&
-               paiScene->mRootNode != nullptr);
-        animations_.reserve(paiScene->mNumAnimations);
-        for (unsigned int i = 0; i < paiScene->mNumAnimations; ++i)
+        auto &loaded = getAnimationsLoaded();
+        animations_.reserve(loaded.size());
+        for (auto &[name, animation] : loaded)
         {
-            auto paiAnimation = paiScene->mAnimations[i];
-            animations_.emplace(paiAnimation->mName.C_Str(), Animation(paiAnimation));
+            animations_.emplace(name, std::move(animation));
             ///////////////////////////////////////////////////////////////
-            curAnim_ = &animations_.at(paiAnimation->mName.C_Str());
-            std::clog << "Set animation: " << paiAnimation->mName.C_Str() // 报菜名
+            curAnim_ = &animations_.at(name);
+            std::clog << "Set animation: " << name // 报菜名
                       << ", duration: " << curAnim_->getDuration()
                       << ", ticks/s: " << curAnim_->getTicksPerSecond() << std::endl;
             ///////////////////////////////////////////////////////////////
         }
+        loaded.clear();
         transforms_.resize(getBonesLoaded().size(), glm::mat4(1.0f));
     }
     void calculateTransform(const Hierarchy *node, glm::mat4 parentTransform)
@@ -62,6 +62,18 @@ public:
             scales_.push_back({Converter::getGLMVec(scl), tickStamp});
         }
     }
+    // 从模型缓存恢复
+    KeyFrame(std::vector<KeyPosition> &&positions,
+             std::vector<KeyRotation> &&rotations,
+             std::vector<KeyScale> &&scales)
+        : positions_(std::move(positions)),
+          rotations_(std::move(rotations)),
+          scales_(std::move(scales)),
+          nextPos_(1),
+          nextRot_(1),
+          nextScl_(1)
+    {
+    }
     ~KeyFrame()
     {
         positions_.clear();
@@ -88,6 +100,9 @@ public:
             KeyFrame(std::move(other)).swap(*this);
         return *this;
     }
+    inline const std::vector<KeyPosition> &getPositions() const { return positions_; }
+    inline const std::vector<KeyRotation> &getRotations() const { return rotations_; }
+    inline const std::vector<KeyScale> &getScales() const { return scales_; }
     const glm::mat4 interpolate(double curTick)
     {
         glm::mat4 transformation = glm::mat4(1.0f);
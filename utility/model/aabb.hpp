@@ -1,8 +1,223 @@
 #ifndef AABB_HPP
 #define AABB_HPP
 
+#include <algorithm>
 #include <glm/glm.hpp>
 
+// 射线: direction归一化, 距离t即世界单位; inverse供slab测试使用, 分量为0时得到±inf
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverse;
+
+    Ray(const glm::vec3 &origin, const glm::vec3 &direction)
+        : origin(origin),
+          direction(glm::normalize(direction)),
+          inverse(1.0f / this->direction) {}
+    inline glm::vec3 at(float t) const { return origin + direction * t; }
+};
+
+// 紧凑包围盒: 只存min/max(24字节), centre/size按需计算, 载荷由容器另外并列存放
+struct Bounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    Bounds() = default;
+    Bounds(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max) {}
+    inline glm::vec3 centre() const { return (min + max) * 0.5f; }
+    inline glm::vec3 size() const { return max - min; }
+    inline bool intersects(const Bounds &other) const
+    {
+        return (min.x <= other.max.x && max.x >= other.min.x) &&
+               (min.y <= other.max.y && max.y >= other.min.y) &&
+               (min.z <= other.max.z && max.z >= other.min.z);
+    }
+    inline bool contains(const Bounds &other) const
+    {
+        return (min.x <= other.min.x && max.x >= other.max.x) &&
+               (min.y <= other.min.y && max.y >= other.max.y) &&
+               (min.z <= other.min.z && max.z >= other.max.z);
+    }
+    inline bool containsPoint(const glm::vec3 &point) const
+    {
+        return (point.x >= min.x && point.x <= max.x) &&
+               (point.y >= min.y && point.y <= max.y) &&
+               (point.z >= min.z && point.z <= max.z);
+    }
+    inline Bounds getGlobalAABB(const glm::vec3 &position) const
+    {
+        return Bounds(min + position, max + position);
+    }
+    // 点到盒子的最近距离平方, 点在盒内时为0
+    inline float distance2(const glm::vec3 &point) const
+    {
+        glm::vec3 d = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+    // 线段ab到盒子的最近距离平方
+    // 距离平方是t的分段二次凸函数, 断点是线段在各轴进出[min, max]的位置, 逐段求极小值
+    inline float distance2(const glm::vec3 &a, const glm::vec3 &b) const
+    {
+        glm::vec3 d = b - a;
+        float ts[8] = {0.0f, 1.0f};
+        int n = 2;
+        for (int axis = 0; axis < 3; ++axis)
+            if (d[axis] != 0.0f)
+                for (float bound : {min[axis], max[axis]})
+                {
+                    float t = (bound - a[axis]) / d[axis];
+                    if (t > 0.0f && t < 1.0f)
+                        ts[n++] = t;
+                }
+        for (int i = 1; i < n; ++i) // 最多8个, 插入排序
+            for (int j = i; j > 0 && ts[j] < ts[j - 1]; --j)
+                std::swap(ts[j], ts[j - 1]);
+        float best = std::min(distance2(a), distance2(b));
+        for (int i = 0; i + 1 < n; ++i)
+        {
+            // 区间内每个轴在盒子下方/内部/上方的状态不变, 只对在外部的轴求导
+            glm::vec3 mid = a + d * (0.5f * (ts[i] + ts[i + 1]));
+            float num = 0.0f, den = 0.0f;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                float bound = mid[axis] < min[axis] ? min[axis] : (mid[axis] > max[axis] ? max[axis] : mid[axis]);
+                if (bound == mid[axis])
+                    continue;
+                num += d[axis] * (bound - a[axis]);
+                den += d[axis] * d[axis];
+            }
+            float t = den > 0.0f ? std::clamp(num / den, ts[i], ts[i + 1]) : ts[i];
+            best = std::min(best, distance2(a + d * t));
+        }
+        return best;
+    }
+    // slab测试: 射线在[0, tMax]内穿过包围盒时返回true, tEnter为进入距离(起点在盒内时为0)
+    inline bool intersectRay(const Ray &ray, float tMax, float &tEnter) const
+    {
+        glm::vec3 t0 = (min - ray.origin) * ray.inverse;
+        glm::vec3 t1 = (max - ray.origin) * ray.inverse;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        return tEnter <= std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+    }
+    inline void print() const
+    {
+        glm::vec3 c = centre();
+        std::cout << "\nmin x:" << min.x << " centre x:" << c.x << " max x:" << max.x
+                  << "\nmin y:" << min.y << " centre y:" << c.y << " max y:" << max.y
+                  << "\nmin z:" << min.z << " centre z:" << c.z << " max z:" << max.z
+                  << std::endl;
+    }
+};
+
+// 球体查询范围
+struct Sphere
+{
+    glm::vec3 centre;
+    float radius;
+
+    Sphere(const glm::vec3 &centre, float radius) : centre(centre), radius(radius) {}
+    inline Bounds getBounds() const { return Bounds(centre - glm::vec3(radius), centre + glm::vec3(radius)); }
+    inline bool intersects(const Bounds &bounds) const { return bounds.distance2(centre) <= radius * radius; }
+};
+
+// 胶囊体(扫掠球)查询范围: 球心从a移动到b
+struct Capsule
+{
+    glm::vec3 a;
+    glm::vec3 b;
+    float radius;
+
+    Capsule(const glm::vec3 &a, const glm::vec3 &b, float radius) : a(a), b(b), radius(radius) {}
+    inline Bounds getBounds() const
+    {
+        return Bounds(glm::min(a, b) - glm::vec3(radius), glm::max(a, b) + glm::vec3(radius));
+    }
+    // 先用端点和"盒子外扩radius后与线段的slab测试"快速判定, 只有落在外扩盒棱角附近的才算精确距离
+    inline bool intersects(const Bounds &bounds) const
+    {
+        float r2 = radius * radius;
+        if (bounds.distance2(a) <= r2 || bounds.distance2(b) <= r2)
+            return true;
+        glm::vec3 d = b - a;
+        float tEnter = 0.0f, tExit = 1.0f;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float lo = bounds.min[axis] - radius, hi = bounds.max[axis] + radius;
+            if (d[axis] == 0.0f)
+            {
+                if (a[axis] < lo || a[axis] > hi)
+                    return false;
+                continue;
+            }
+            float t0 = (lo - a[axis]) / d[axis], t1 = (hi - a[axis]) / d[axis];
+            tEnter = std::max(tEnter, std::min(t0, t1));
+            tExit = std::min(tExit, std::max(t0, t1));
+        }
+        if (tEnter > tExit)
+            return false;
+        // 从面进入外扩盒时进入点就在radius之内
+        if (bounds.distance2(a + d * tEnter) <= r2)
+            return true;
+        return bounds.distance2(a, b) <= r2;
+    }
+};
+
+// 三角形abc上离point最近的点, 按point落在的Voronoi区域(顶点/边/面)分别求解
+// barycentric = (u, v), 结果 = (1 - u - v) * a + u * b + v * c
+inline glm::vec3 closestPointOnTriangle(const glm::vec3 &point,
+                                        const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c,
+                                        glm::vec2 &barycentric)
+{
+    glm::vec3 ab = b - a, ac = c - a, ap = point - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+    {
+        barycentric = glm::vec2(0.0f, 0.0f);
+        return a;
+    }
+    glm::vec3 bp = point - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3)
+    {
+        barycentric = glm::vec2(1.0f, 0.0f);
+        return b;
+    }
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        float u = d1 / (d1 - d3);
+        barycentric = glm::vec2(u, 0.0f);
+        return a + ab * u;
+    }
+    glm::vec3 cp = point - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6)
+    {
+        barycentric = glm::vec2(0.0f, 1.0f);
+        return c;
+    }
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        float v = d2 / (d2 - d6);
+        barycentric = glm::vec2(0.0f, v);
+        return a + ac * v;
+    }
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+    {
+        float v = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        barycentric = glm::vec2(1.0f - v, v);
+        return b + (c - b) * v;
+    }
+    float denom = 1.0f / (va + vb + vc);
+    barycentric = glm::vec2(vb * denom, vc * denom);
+    return a + ab * barycentric.x + ac * barycentric.y;
+}
+
 struct AABB
 {
     glm::vec3 min;
@@ -19,6 +234,9 @@ struct AABB
           centre((min + max) * 0.5f),
           size(max - min),
           where(where) {}
+    AABB(const Bounds &bounds,
+         void *where = nullptr)
+        : AABB(bounds.min, bounds.max, where) {}
     ~AABB() = default;
     AABB(const AABB &) = default;
     AABB &operator=(const AABB &) = default;
@@ -0,0 +1,330 @@
+#ifndef BAKED_TEXTURE_HPP
+#define BAKED_TEXTURE_HPP
+
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+#define BAKED_TEXTURE_MAGIC 0x5854334du // "M3TX"
+#define BAKED_TEXTURE_VERSION 1u        // 布局有变化时加1, 旧文件自动作废
+#define BAKED_TEXTURE_EXTENSION ".baked"
+
+enum class BakedFormat : std::uint32_t
+{
+    R8,
+    RGB8,
+    RGBA8,
+    BC1, // 4x4块8字节, 不透明RGB
+    BC3, // 4x4块16字节, BC1颜色加插值alpha
+};
+
+// 离线烘焙的纹理, 写在原图旁边(wall.png -> wall.png.baked), 加载时不解码也不生成mipmap
+// 文件: magic, version, 原图修改时间, 格式, 宽, 高, 层数, 各层字节数, 之后依次是各层数据
+// 原图不在时(只发布烘焙文件)直接使用, 在时修改时间必须一致
+struct BakedTexture
+{
+    BakedFormat format = BakedFormat::RGBA8;
+    int width = 0;
+    int height = 0;
+    std::vector<std::vector<unsigned char>> levels; // levels[0]为原始分辨率
+
+    inline bool empty() const { return levels.empty(); }
+    inline bool isCompressed() const { return BakedFormat::BC1 == format || BakedFormat::BC3 == format; }
+    inline std::size_t bytes() const
+    {
+        std::size_t total = 0;
+        for (auto &level : levels)
+            total += level.size();
+        return total;
+    }
+    // 与运行时glTextureStorage2D用的层数一致
+    static inline int levelCount(int width, int height)
+    {
+        return 1 + static_cast<int>(std::log2(std::max(width, height)));
+    }
+    // 由解码后的像素生成完整mip链(2x2盒式滤波); compress时3通道压成BC1, 4通道压成BC3, 单通道不压缩
+    static BakedTexture bake(const unsigned char *pixels, int width, int height, int comp, bool compress)
+    {
+        assert(pixels != nullptr && width > 0 && height > 0);
+        assert(1 == comp || 3 == comp || 4 == comp);
+        BakedTexture baked;
+        baked.width = width;
+        baked.height = height;
+        baked.format = 1 == comp ? BakedFormat::R8 : 3 == comp ? BakedFormat::RGB8 : BakedFormat::RGBA8;
+        if (compress && comp > 1)
+            baked.format = 3 == comp ? BakedFormat::BC1 : BakedFormat::BC3;
+        std::vector<unsigned char> level(pixels, pixels + static_cast<std::size_t>(width) * height * comp);
+        int count = levelCount(width, height);
+        baked.levels.reserve(count);
+        for (int l = 0; l < count; ++l)
+        {
+            int w = std::max(1, width >> l), h = std::max(1, height >> l);
+            baked.levels.push_back(baked.isCompressed() ? compressLevel(level.data(), w, h, comp, BakedFormat::BC3 == baked.format) : level);
+            if (l + 1 < count)
+                level = downsample(level, w, h, comp);
+        }
+        return baked;
+    }
+    // 第level层的宽高
+    inline int levelWidth(int level) const { return std::max(1, width >> level); }
+    inline int levelHeight(int level) const { return std::max(1, height >> level); }
+    // 一层w*h的数据应有的字节数: 未压缩为w*h*通道数, 压缩为4x4块数*8(BC1)或*16(BC3)
+    static inline std::uint64_t levelBytes(BakedFormat format, int w, int h)
+    {
+        std::uint64_t blocks = static_cast<std::uint64_t>((w + 3) / 4) * ((h + 3) / 4);
+        switch (format)
+        {
+        case BakedFormat::R8:
+            return static_cast<std::uint64_t>(w) * h;
+        case BakedFormat::RGB8:
+            return static_cast<std::uint64_t>(w) * h * 3;
+        case BakedFormat::RGBA8:
+            return static_cast<std::uint64_t>(w) * h * 4;
+        case BakedFormat::BC1:
+            return blocks * 8;
+        case BakedFormat::BC3:
+            return blocks * 16;
+        }
+        return 0;
+    }
+    // 从内存中的烘焙文件读出, source为原图路径, 用来校验修改时间
+    bool parse(const unsigned char *data, std::size_t size, const std::filesystem::path &source)
+    {
+        const unsigned char *cursor = data, *end = data + size;
+        auto read = [&](void *out, std::size_t length)
+        {
+            if (static_cast<std::size_t>(end - cursor) < length)
+                return false;
+            std::memcpy(out, cursor, length);
+            cursor += length;
+            return true;
+        };
+        std::uint32_t magic = 0, version = 0, count = 0;
+        std::int64_t stamp = 0;
+        std::int32_t w = 0, h = 0;
+        BakedFormat f;
+        std::error_code ec;
+        if (!read(&magic, sizeof(magic)) || BAKED_TEXTURE_MAGIC != magic ||
+            !read(&version, sizeof(version)) || BAKED_TEXTURE_VERSION != version ||
+            !read(&stamp, sizeof(stamp)) || (std::filesystem::exists(source, ec) && getStamp(source) != stamp) ||
+            !read(&f, sizeof(f)) || f > BakedFormat::BC3 ||
+            !read(&w, sizeof(w)) || !read(&h, sizeof(h)) || w <= 0 || h <= 0 ||
+            !read(&count, sizeof(count)) || static_cast<int>(count) != levelCount(w, h))
+            return false;
+        std::vector<std::uint64_t> sizes(count);
+        if (!read(sizes.data(), count * sizeof(std::uint64_t)))
+            return false;
+        std::vector<std::vector<unsigned char>> loaded(count);
+        for (std::uint32_t l = 0; l < count; ++l)
+        {
+            if (levelBytes(f, std::max(1, w >> l), std::max(1, h >> l)) != sizes[l] ||
+                static_cast<std::uint64_t>(end - cursor) < sizes[l])
+                return false;
+            loaded[l].assign(cursor, cursor + sizes[l]);
+            cursor += sizes[l];
+        }
+        format = f;
+        width = w;
+        height = h;
+        levels = std::move(loaded);
+        return true;
+    }
+    // 先写临时文件再改名
+    bool save(const std::filesystem::path &source) const
+    {
+        std::error_code ec;
+        auto path = getPath(source);
+        auto temp = path;
+        temp += ".tmp";
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            auto write = [&](const void *data, std::size_t size)
+            { out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size)); };
+            std::uint32_t header[2] = {BAKED_TEXTURE_MAGIC, BAKED_TEXTURE_VERSION};
+            std::int64_t stamp = getStamp(source);
+            std::int32_t size[2] = {width, height};
+            std::uint32_t count = static_cast<std::uint32_t>(levels.size());
+            write(header, sizeof(header));
+            write(&stamp, sizeof(stamp));
+            write(&format, sizeof(format));
+            write(size, sizeof(size));
+            write(&count, sizeof(count));
+            for (auto &level : levels)
+            {
+                std::uint64_t bytes = level.size();
+                write(&bytes, sizeof(bytes));
+            }
+            for (auto &level : levels)
+                write(level.data(), level.size());
+            if (!out)
+                return false;
+        }
+        std::filesystem::rename(temp, path, ec);
+        if (ec)
+            std::filesystem::remove(temp, ec);
+        return !ec;
+    }
+    static inline std::filesystem::path getPath(const std::filesystem::path &source)
+    {
+        auto path = source;
+        path += BAKED_TEXTURE_EXTENSION;
+        return path;
+    }
+
+private:
+    static inline std::int64_t getStamp(const std::filesystem::path &source)
+    {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(source, ec);
+        return ec ? 0 : static_cast<std::int64_t>(time.time_since_epoch().count());
+    }
+    // 奇数边长时最后一行/列只和自己平均
+    static std::vector<unsigned char> downsample(const std::vector<unsigned char> &src, int width, int height, int comp)
+    {
+        int w = std::max(1, width >> 1), h = std::max(1, height >> 1);
+        std::vector<unsigned char> dst(static_cast<std::size_t>(w) * h * comp);
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+            {
+                int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+                for (int c = 0; c < comp; ++c)
+                {
+                    int sum = src[(static_cast<std::size_t>(y0) * width + x0) * comp + c] +
+                              src[(static_cast<std::size_t>(y0) * width + x1) * comp + c] +
+                              src[(static_cast<std::size_t>(y1) * width + x0) * comp + c] +
+                              src[(static_cast<std::size_t>(y1) * width + x1) * comp + c];
+                    dst[(static_cast<std::size_t>(y) * w + x) * comp + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        return dst;
+    }
+    static std::vector<unsigned char> compressLevel(const unsigned char *pixels, int width, int height, int comp, bool alpha)
+    {
+        int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        std::vector<unsigned char> out(static_cast<std::size_t>(blocksX) * blocksY * (alpha ? 16 : 8));
+        unsigned char *cursor = out.data();
+        unsigned char block[16][4];
+        for (int by = 0; by < blocksY; ++by)
+            for (int bx = 0; bx < blocksX; ++bx)
+            {
+                // 不满4x4的边缘块重复最后一行/列
+                for (int i = 0; i < 16; ++i)
+                {
+                    int x = std::min(bx * 4 + i % 4, width - 1), y = std::min(by * 4 + i / 4, height - 1);
+                    const unsigned char *p = pixels + (static_cast<std::size_t>(y) * width + x) * comp;
+                    block[i][0] = p[0];
+                    block[i][1] = p[1];
+                    block[i][2] = p[2];
+                    block[i][3] = 4 == comp ? p[3] : 255;
+                }
+                if (alpha)
+                {
+                    compressAlphaBlock(block, cursor);
+                    cursor += 8;
+                }
+                compressColorBlock(block, cursor);
+                cursor += 8;
+            }
+        return out;
+    }
+    static inline std::uint16_t to565(const int color[3])
+    {
+        return static_cast<std::uint16_t>(((color[0] * 31 + 127) / 255) << 11 |
+                                          ((color[1] * 63 + 127) / 255) << 5 |
+                                          ((color[2] * 31 + 127) / 255));
+    }
+    static inline void from565(std::uint16_t packed, int color[3])
+    {
+        int r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+        color[0] = r << 3 | r >> 2;
+        color[1] = g << 2 | g >> 4;
+        color[2] = b << 3 | b >> 2;
+    }
+    // 端点取包围盒两角并向内收1/16, 总用4色模式(BC3的颜色块只支持这一种)
+    static void compressColorBlock(const unsigned char block[16][4], unsigned char *out)
+    {
+        int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 3; ++c)
+            {
+                lo[c] = std::min<int>(lo[c], block[i][c]);
+                hi[c] = std::max<int>(hi[c], block[i][c]);
+            }
+        for (int c = 0; c < 3; ++c)
+        {
+            int inset = (hi[c] - lo[c]) / 16;
+            lo[c] += inset;
+            hi[c] -= inset;
+        }
+        std::uint16_t c0 = to565(hi), c1 = to565(lo);
+        std::uint32_t indices = 0;
+        if (c0 < c1)
+            std::swap(c0, c1);
+        if (c0 != c1)
+        {
+            int palette[4][3];
+            from565(c0, palette[0]);
+            from565(c1, palette[1]);
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0, bestDistance = INT32_MAX;
+                for (int k = 0; k < 4; ++k)
+                {
+                    int distance = 0;
+                    for (int c = 0; c < 3; ++c)
+                        distance += (block[i][c] - palette[k][c]) * (block[i][c] - palette[k][c]);
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = k;
+                    }
+                }
+                indices |= static_cast<std::uint32_t>(best) << (2 * i);
+            }
+        }
+        std::memcpy(out, &c0, 2);
+        std::memcpy(out + 2, &c1, 2);
+        std::memcpy(out + 4, &indices, 4);
+    }
+    // a0 > a1时为8级插值模式
+    static void compressAlphaBlock(const unsigned char block[16][4], unsigned char *out)
+    {
+        int a0 = 0, a1 = 255;
+        for (int i = 0; i < 16; ++i)
+        {
+            a0 = std::max<int>(a0, block[i][3]);
+            a1 = std::min<int>(a1, block[i][3]);
+        }
+        std::uint64_t packed = static_cast<std::uint64_t>(a0) | static_cast<std::uint64_t>(a1) << 8;
+        if (a0 != a1)
+        {
+            int palette[8] = {a0, a1};
+            for (int k = 1; k < 7; ++k)
+                palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0;
+                for (int k = 1; k < 8; ++k)
+                    if (std::abs(block[i][3] - palette[k]) < std::abs(block[i][3] - palette[best]))
+                        best = k;
+                packed |= static_cast<std::uint64_t>(best) << (16 + 3 * i);
+            }
+        }
+        std::memcpy(out, &packed, 8);
+    }
+};
+
+#endif
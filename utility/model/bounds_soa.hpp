@@ -0,0 +1,115 @@
+#ifndef BOUNDS_SOA_HPP
+#define BOUNDS_SOA_HPP
+
+#include <vector>
+#include <limits>
+#include <bit>
+#include <glm/glm.hpp>
+#include "aabb.hpp"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define BOUNDS_SOA_WIDTH 8 // 一次批量测试的盒子数
+
+// 按分量分开存放的一组包围盒, 供批量相交测试使用
+struct BoundsSoA
+{
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+
+    inline std::size_t size() const { return minX.size(); }
+    inline void push_back(const Bounds &bounds)
+    {
+        minX.push_back(bounds.min.x);
+        minY.push_back(bounds.min.y);
+        minZ.push_back(bounds.min.z);
+        maxX.push_back(bounds.max.x);
+        maxY.push_back(bounds.max.y);
+        maxZ.push_back(bounds.max.z);
+    }
+    inline Bounds operator[](std::size_t i) const
+    {
+        return Bounds(glm::vec3(minX[i], minY[i], minZ[i]), glm::vec3(maxX[i], maxY[i], maxZ[i]));
+    }
+    // 末尾补BOUNDS_SOA_WIDTH个永不相交的盒子, 使任意合法下标起读满一批都不越界
+    void pad()
+    {
+        constexpr float inf = std::numeric_limits<float>::infinity();
+        for (int i = 0; i < BOUNDS_SOA_WIDTH; ++i)
+            push_back(Bounds(glm::vec3(inf), glm::vec3(-inf)));
+    }
+    void clear()
+    {
+        for (auto v : {&minX, &minY, &minZ, &maxX, &maxY, &maxZ})
+            v->clear();
+    }
+    void shrink_to_fit()
+    {
+        for (auto v : {&minX, &minY, &minZ, &maxX, &maxY, &maxZ})
+            v->shrink_to_fit();
+    }
+};
+
+// range与soa中从first开始的4/8个盒子的相交测试, 返回位掩码(第i位对应first+i)
+class Overlap
+{
+public:
+    static inline unsigned int test4Scalar(const BoundsSoA &soa, std::size_t first, const Bounds &range)
+    {
+        unsigned int mask = 0;
+        for (int i = 0; i < 4; ++i)
+            mask |= static_cast<unsigned int>(soa.minX[first + i] <= range.max.x && soa.maxX[first + i] >= range.min.x &&
+                                              soa.minY[first + i] <= range.max.y && soa.maxY[first + i] >= range.min.y &&
+                                              soa.minZ[first + i] <= range.max.z && soa.maxZ[first + i] >= range.min.z)
+                    << i;
+        return mask;
+    }
+    static inline unsigned int test8Scalar(const BoundsSoA &soa, std::size_t first, const Bounds &range)
+    {
+        return test4Scalar(soa, first, range) | (test4Scalar(soa, first + 4, range) << 4);
+    }
+    static inline unsigned int test4(const BoundsSoA &soa, std::size_t first, const Bounds &range)
+    {
+#if defined(__SSE2__)
+        __m128 m = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&soa.minX[first]), _mm_set1_ps(range.max.x)),
+                              _mm_cmpge_ps(_mm_loadu_ps(&soa.maxX[first]), _mm_set1_ps(range.min.x)));
+        m = _mm_and_ps(m, _mm_cmple_ps(_mm_loadu_ps(&soa.minY[first]), _mm_set1_ps(range.max.y)));
+        m = _mm_and_ps(m, _mm_cmpge_ps(_mm_loadu_ps(&soa.maxY[first]), _mm_set1_ps(range.min.y)));
+        m = _mm_and_ps(m, _mm_cmple_ps(_mm_loadu_ps(&soa.minZ[first]), _mm_set1_ps(range.max.z)));
+        m = _mm_and_ps(m, _mm_cmpge_ps(_mm_loadu_ps(&soa.maxZ[first]), _mm_set1_ps(range.min.z)));
+        return static_cast<unsigned int>(_mm_movemask_ps(m));
+#else
+        return test4Scalar(soa, first, range);
+#endif
+    }
+    static inline unsigned int test8(const BoundsSoA &soa, std::size_t first, const Bounds &range)
+    {
+#if defined(__AVX2__)
+        __m256 m = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&soa.minX[first]), _mm256_set1_ps(range.max.x), _CMP_LE_OQ),
+                                 _mm256_cmp_ps(_mm256_loadu_ps(&soa.maxX[first]), _mm256_set1_ps(range.min.x), _CMP_GE_OQ));
+        m = _mm256_and_ps(m, _mm256_cmp_ps(_mm256_loadu_ps(&soa.minY[first]), _mm256_set1_ps(range.max.y), _CMP_LE_OQ));
+        m = _mm256_and_ps(m, _mm256_cmp_ps(_mm256_loadu_ps(&soa.maxY[first]), _mm256_set1_ps(range.min.y), _CMP_GE_OQ));
+        m = _mm256_and_ps(m, _mm256_cmp_ps(_mm256_loadu_ps(&soa.minZ[first]), _mm256_set1_ps(range.max.z), _CMP_LE_OQ));
+        m = _mm256_and_ps(m, _mm256_cmp_ps(_mm256_loadu_ps(&soa.maxZ[first]), _mm256_set1_ps(range.min.z), _CMP_GE_OQ));
+        return static_cast<unsigned int>(_mm256_movemask_ps(m));
+#else
+        return test4(soa, first, range) | (test4(soa, first + 4, range) << 4);
+#endif
+    }
+    // 对soa[first, first + count)逐批测试, 命中的下标交给visitor
+    template <typename Visitor>
+    static inline void testRange(const BoundsSoA &soa, std::size_t first, std::size_t count, const Bounds &range, Visitor &&visitor)
+    {
+        for (std::size_t i = first; i < first + count; i += BOUNDS_SOA_WIDTH)
+        {
+            unsigned int mask = test8(soa, i, range);
+            if (first + count - i < BOUNDS_SOA_WIDTH)
+                mask &= (1u << (first + count - i)) - 1;
+            for (; mask; mask &= mask - 1)
+                visitor(i + std::countr_zero(mask));
+        }
+    }
+};
+
+#endif
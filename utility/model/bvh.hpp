@@ -0,0 +1,341 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <glm/glm.hpp>
+#include "aabb.hpp"
+
+#define BVH_MAX_LEAF_OBJECTS 2
+#define BVH_SAH_BINS 12
+#define BVH_TRAVERSAL_COST 1.0f // 相对于一次物体相交测试的代价
+
+// 用表面积启发式(SAH)分箱构建的包围体层次, 与Octree回答同样的范围查询, 载荷约定同BasicOctree
+template <typename Payload = void *>
+class BasicBVH
+{
+    struct BVHNode
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+        unsigned int first = 0; // 叶子: 第一个物体; 内部节点: 左孩子(右孩子紧随其后)
+        unsigned int count = 0; // 0表示内部节点
+    };
+    std::vector<BVHNode> nodes_;
+    std::vector<Bounds> objects_;
+    std::vector<Payload> payloads_; // 与objects_一一对应
+
+public:
+    BasicBVH() = default;
+    BasicBVH(std::vector<Bounds> &&objects, std::vector<Payload> &&payloads)
+    {
+        assert(objects.size() == payloads.size());
+        if (objects.empty())
+            return;
+        // 构建时只重排下标, 最后一次性按叶子顺序重排物体与载荷
+        std::vector<unsigned int> order(objects.size());
+        std::vector<glm::vec3> centres(objects.size());
+        for (std::size_t i = 0; i < objects.size(); ++i)
+        {
+            order[i] = static_cast<unsigned int>(i);
+            centres[i] = objects[i].centre();
+        }
+        nodes_.reserve(objects.size() * 2);
+        nodes_.push_back(BVHNode{});
+        subdivide(0, 0, static_cast<unsigned int>(objects.size()), objects, centres, order);
+        nodes_.shrink_to_fit();
+        objects_.reserve(order.size());
+        payloads_.reserve(order.size());
+        for (auto i : order)
+        {
+            objects_.push_back(objects[i]);
+            payloads_.push_back(payloads[i]);
+        }
+    }
+    ~BasicBVH() = default;
+    BasicBVH(const BasicBVH &) = delete;
+    BasicBVH &operator=(const BasicBVH &) = delete;
+    BasicBVH(BasicBVH &&) = default;
+    BasicBVH &operator=(BasicBVH &&) = default;
+    inline bool empty() const { return nodes_.empty(); }
+    std::vector<AABB> query(const Bounds &range) const
+        requires std::is_same_v<Payload, void *>
+    {
+        std::vector<AABB> result;
+        visit(range, [&](const Bounds &obj, Payload where)
+              { result.emplace_back(obj, where); });
+        return result;
+    }
+    template <typename Visitor>
+    inline void query(const Bounds &range, Visitor &&visitor) const
+    {
+        visit(range, [&](const Bounds &, Payload where)
+              { visitor(where); });
+    }
+    inline void query(const Bounds &range, std::vector<Payload> &result) const
+    {
+        visit(range, [&](const Bounds &, Payload where)
+              { result.push_back(where); });
+    }
+    template <typename Visitor>
+    inline void query(const Sphere &sphere, Visitor &&visitor) const { visitShape(sphere, visitor); }
+    template <typename Visitor>
+    inline void query(const Capsule &capsule, Visitor &&visitor) const { visitShape(capsule, visitor); }
+    // 与Octree::raycast相同的约定, 先访问进入距离较近的孩子
+    template <typename Visitor>
+    bool raycast(const Ray &ray, float tMax, Visitor &&visitor) const
+    {
+        assert(!empty());
+        float tEnter;
+        return intersectRay(nodes_[0], ray, tMax, tEnter) && raycast(0, ray, tMax, visitor);
+    }
+    // 与Octree::nearest相同的约定, 先访问离point较近的孩子
+    template <typename Visitor>
+    void nearest(const glm::vec3 &point, float maxDistance2, Visitor &&visitor) const
+    {
+        assert(!empty());
+        if (Bounds(nodes_[0].min, nodes_[0].max).distance2(point) <= maxDistance2)
+            nearest(0, point, maxDistance2, visitor);
+    }
+    inline const glm::vec3 &getMin() const
+    {
+        assert(!empty());
+        return nodes_[0].min;
+    }
+    inline const glm::vec3 &getMax() const
+    {
+        assert(!empty());
+        return nodes_[0].max;
+    }
+    inline std::size_t getNodeCount() const { return nodes_.size(); }
+
+private:
+    static inline float surfaceArea(const glm::vec3 &min, const glm::vec3 &max)
+    {
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+    static inline bool overlaps(const BVHNode &node, const Bounds &range)
+    {
+        return (node.min.x <= range.max.x && node.max.x >= range.min.x) &&
+               (node.min.y <= range.max.y && node.max.y >= range.min.y) &&
+               (node.min.z <= range.max.z && node.max.z >= range.min.z);
+    }
+    static inline bool intersectRay(const BVHNode &node, const Ray &ray, float tMax, float &tEnter)
+    {
+        return Bounds(node.min, node.max).intersectRay(ray, tMax, tEnter);
+    }
+    void subdivide(unsigned int idx, unsigned int first, unsigned int count,
+                   const std::vector<Bounds> &objects,
+                   const std::vector<glm::vec3> &centres,
+                   std::vector<unsigned int> &order)
+    {
+        glm::vec3 min = objects[order[first]].min, max = objects[order[first]].max;
+        glm::vec3 cmin = centres[order[first]], cmax = centres[order[first]];
+        for (unsigned int i = first + 1; i < first + count; ++i)
+        {
+            min = glm::min(min, objects[order[i]].min);
+            max = glm::max(max, objects[order[i]].max);
+            cmin = glm::min(cmin, centres[order[i]]);
+            cmax = glm::max(cmax, centres[order[i]]);
+        }
+        nodes_[idx].min = min;
+        nodes_[idx].max = max;
+        nodes_[idx].first = first;
+        nodes_[idx].count = count;
+        if (count <= BVH_MAX_LEAF_OBJECTS)
+            return;
+        // 在质心包围盒的三个轴上分箱, 找代价最小的切分面
+        int bestAxis = -1;
+        int bestSplit = 0;
+        float bestCost = count * surfaceArea(min, max);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float extent = cmax[axis] - cmin[axis];
+            if (extent <= 0.0f)
+                continue;
+            unsigned int binCount[BVH_SAH_BINS] = {0};
+            glm::vec3 binMin[BVH_SAH_BINS], binMax[BVH_SAH_BINS];
+            float scale = BVH_SAH_BINS / extent;
+            for (unsigned int i = first; i < first + count; ++i)
+            {
+                auto &obj = objects[order[i]];
+                int b = std::min(BVH_SAH_BINS - 1, static_cast<int>((centres[order[i]][axis] - cmin[axis]) * scale));
+                if (binCount[b]++ == 0)
+                {
+                    binMin[b] = obj.min;
+                    binMax[b] = obj.max;
+                }
+                else
+                {
+                    binMin[b] = glm::min(binMin[b], obj.min);
+                    binMax[b] = glm::max(binMax[b], obj.max);
+                }
+            }
+            // 从右往左累积右侧面积, 再从左往右扫描
+            float rightArea[BVH_SAH_BINS - 1];
+            unsigned int rightCount[BVH_SAH_BINS - 1];
+            glm::vec3 accMin(0.0f), accMax(0.0f);
+            unsigned int acc = 0;
+            for (int b = BVH_SAH_BINS - 1; b > 0; --b)
+            {
+                if (binCount[b] > 0)
+                {
+                    accMin = acc == 0 ? binMin[b] : glm::min(accMin, binMin[b]);
+                    accMax = acc == 0 ? binMax[b] : glm::max(accMax, binMax[b]);
+                    acc += binCount[b];
+                }
+                rightCount[b - 1] = acc;
+                rightArea[b - 1] = acc == 0 ? 0.0f : surfaceArea(accMin, accMax);
+            }
+            acc = 0;
+            for (int b = 0; b < BVH_SAH_BINS - 1; ++b)
+            {
+                if (binCount[b] > 0)
+                {
+                    accMin = acc == 0 ? binMin[b] : glm::min(accMin, binMin[b]);
+                    accMax = acc == 0 ? binMax[b] : glm::max(accMax, binMax[b]);
+                    acc += binCount[b];
+                }
+                if (acc == 0 || rightCount[b] == 0)
+                    continue;
+                float cost = BVH_TRAVERSAL_COST * surfaceArea(min, max) +
+                             acc * surfaceArea(accMin, accMax) +
+                             rightCount[b] * rightArea[b];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+        if (bestAxis == -1)
+            return; // 切分不划算(或所有质心重合), 保持为叶子
+        float scale = BVH_SAH_BINS / (cmax[bestAxis] - cmin[bestAxis]);
+        auto middle = std::partition(order.begin() + first,
+                                     order.begin() + first + count,
+                                     [&](unsigned int i)
+                                     { return std::min(BVH_SAH_BINS - 1, static_cast<int>((centres[i][bestAxis] - cmin[bestAxis]) * scale)) <= bestSplit; });
+        unsigned int leftCount = static_cast<unsigned int>(middle - order.begin()) - first;
+        assert(leftCount > 0 && leftCount < count);
+        unsigned int left = static_cast<unsigned int>(nodes_.size());
+        nodes_.push_back(BVHNode{});
+        nodes_.push_back(BVHNode{});
+        nodes_[idx].first = left;
+        nodes_[idx].count = 0;
+        subdivide(left, first, leftCount, objects, centres, order);
+        subdivide(left + 1, first + leftCount, count - leftCount, objects, centres, order);
+    }
+    template <typename Visitor>
+    inline void visit(const Bounds &range, Visitor &&visitor) const
+    {
+        visit(range, visitor, [](const BVHNode &)
+              { return true; });
+    }
+    // filter(node)在盒测试通过后再细筛节点
+    template <typename Visitor, typename Filter>
+    void visit(const Bounds &range, Visitor &&visitor, Filter &&filter) const
+    {
+        assert(!empty());
+        visit(0u, range, visitor, filter);
+    }
+    template <typename Visitor, typename Filter>
+    void visit(unsigned int idx, const Bounds &range, Visitor &visitor, Filter &filter) const
+    {
+        auto &node = nodes_[idx];
+        if (!overlaps(node, range) || !filter(node))
+            return;
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+                if (objects_[i].intersects(range))
+                    visitor(objects_[i], payloads_[i]);
+            return;
+        }
+        visit(node.first, range, visitor, filter);
+        visit(node.first + 1, range, visitor, filter);
+    }
+    template <typename Shape, typename Visitor>
+    void visitShape(const Shape &shape, Visitor &visitor) const
+    {
+        assert(!empty());
+        Bounds range = shape.getBounds();
+        visit(range, [&](const Bounds &obj, Payload where)
+              {
+                  if (shape.intersects(obj))
+                      visitor(where); },
+              [&](const BVHNode &node)
+              { return shape.intersects(Bounds(node.min, node.max)); });
+    }
+    template <typename Visitor>
+    bool raycast(unsigned int idx, const Ray &ray, float &tMax, Visitor &visitor) const
+    {
+        auto &node = nodes_[idx];
+        float tEnter;
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+                if (objects_[i].intersectRay(ray, tMax, tEnter) && visitor(payloads_[i], tMax))
+                    return true;
+            return false;
+        }
+        unsigned int near = node.first, far = node.first + 1;
+        float tNear, tFar;
+        bool hitNear = intersectRay(nodes_[near], ray, tMax, tNear);
+        bool hitFar = intersectRay(nodes_[far], ray, tMax, tFar);
+        if (hitNear && hitFar && tFar < tNear)
+        {
+            std::swap(near, far);
+            std::swap(tNear, tFar);
+        }
+        else if (!hitNear)
+        {
+            near = far;
+            tNear = tFar;
+            hitNear = hitFar;
+            hitFar = false;
+        }
+        if (hitNear && raycast(near, ray, tMax, visitor))
+            return true;
+        return hitFar && tFar <= tMax && raycast(far, ray, tMax, visitor);
+    }
+    template <typename Visitor>
+    void nearest(unsigned int idx, const glm::vec3 &point, float &maxDistance2, Visitor &visitor) const
+    {
+        auto &node = nodes_[idx];
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+                if (objects_[i].distance2(point) <= maxDistance2)
+                    visitor(payloads_[i], maxDistance2);
+            return;
+        }
+        unsigned int near = node.first, far = node.first + 1;
+        float dNear = Bounds(nodes_[near].min, nodes_[near].max).distance2(point);
+        float dFar = Bounds(nodes_[far].min, nodes_[far].max).distance2(point);
+        if (dFar < dNear)
+        {
+            std::swap(near, far);
+            std::swap(dNear, dFar);
+        }
+        if (dNear <= maxDistance2)
+            nearest(near, point, maxDistance2, visitor);
+        if (dFar <= maxDistance2)
+            nearest(far, point, maxDistance2, visitor);
+    }
+};
+
+using BVH = BasicBVH<>;
+using TriangleBVH = BasicBVH<std::uint32_t>;
+// 场景三角形索引(Model::buildSceneIndex)的载荷: 第mesh个网格的第triangle个三角形
+struct MeshTriangle
+{
+    std::uint32_t mesh;
+    std::uint32_t triangle;
+};
+using SceneBVH = BasicBVH<MeshTriangle>;
+
+#endif
@@ -5,9 +5,14 @@
 #include <sstream>
 #include <assimp/matrix4x4.h>
 #include <assimp/quaternion.h>
+#include <assimp/postprocess.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+// Model与基准测试共用的导入参数, 网格, 层级与动画都从这一次导入中读取
+#define ASSIMP_IMPORT_FLAGS (aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_GenSmoothNormals | \
+                             aiProcess_LimitBoneWeights | aiProcess_JoinIdenticalVertices | aiProcess_ConvertToLeftHanded)
+
 class Converter
 {
 public:
@@ -0,0 +1,55 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include <glm/glm.hpp>
+#include "aabb.hpp"
+
+// 视锥体: 从裁剪矩阵(projection * view * model)直接提取6个平面, 平面法线朝内
+// 传入含model矩阵的裁剪矩阵时, 平面位于模型空间, 可以直接测试模型空间的包围盒
+struct Frustum
+{
+    enum class Side
+    {
+        OUTSIDE,
+        INTERSECT,
+        INSIDE,
+    };
+    glm::vec4 planes[6]; // 左 右 下 上 近 远, (a, b, c, d): ax + by + cz + d >= 0 为内侧
+
+    Frustum(const glm::mat4 &clip)
+    {
+        // glm按列存储, 第i行为(clip[0][i], clip[1][i], clip[2][i], clip[3][i])
+        auto row = [&](int i)
+        { return glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]); };
+        glm::vec4 x = row(0), y = row(1), z = row(2), w = row(3);
+        planes[0] = w + x;
+        planes[1] = w - x;
+        planes[2] = w + y;
+        planes[3] = w - y;
+        planes[4] = w + z; // OpenGL深度范围[-1, 1]
+        planes[5] = w - z;
+    }
+    // 对每个平面只测离它最远(正顶点)和最近(负顶点)的两个角
+    inline Side classify(const Bounds &bounds) const
+    {
+        Side side = Side::INSIDE;
+        for (auto &plane : planes)
+        {
+            glm::vec3 normal(plane.x, plane.y, plane.z);
+            glm::vec3 positive(normal.x >= 0.0f ? bounds.max.x : bounds.min.x,
+                               normal.y >= 0.0f ? bounds.max.y : bounds.min.y,
+                               normal.z >= 0.0f ? bounds.max.z : bounds.min.z);
+            if (glm::dot(normal, positive) + plane.w < 0.0f)
+                return Side::OUTSIDE;
+            glm::vec3 negative(normal.x >= 0.0f ? bounds.min.x : bounds.max.x,
+                               normal.y >= 0.0f ? bounds.min.y : bounds.max.y,
+                               normal.z >= 0.0f ? bounds.min.z : bounds.max.z);
+            if (glm::dot(normal, negative) + plane.w < 0.0f)
+                side = Side::INTERSECT;
+        }
+        return side;
+    }
+    inline bool intersects(const Bounds &bounds) const { return classify(bounds) != Side::OUTSIDE; }
+};
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef LOOSE_OCTREE_HPP
+#define LOOSE_OCTREE_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "aabb.hpp"
+
+#define LOOSE_OCTREE_MAX_DEPTH 4
+#define LOOSE_OCTREE_LOOSENESS 2.0f // 节点松散包围盒边长 = 格子边长 * LOOSENESS
+
+// 给运动物体用的松散八叉树
+// 节点是固定深度的满树, 按层连续存放, 下标由层和格子坐标直接算出, 不需要分裂与合并
+// 物体按自身大小选层, 按中心选格子, 所以insert/remove/update都是常数时间
+class LooseOctree
+{
+    struct Entry
+    {
+        Bounds bounds;
+        void *where = nullptr;
+        unsigned int node = 0;
+        unsigned int slot = 0; // 在节点entries中的位置
+    };
+    struct LooseNode
+    {
+        std::vector<unsigned int> entries;
+        unsigned int population = 0; // 子树(含自身)中的物体数, 为0时整棵子树跳过
+    };
+    Bounds world_;
+    int maxDepth_;
+    std::vector<LooseNode> nodes_;
+    std::vector<unsigned int> levelOffsets_;
+    std::vector<Entry> entries_;
+    std::vector<unsigned int> freeEntries_;
+
+public:
+    LooseOctree(const Bounds &world = Bounds(glm::vec3(-1.0f), glm::vec3(1.0f)),
+                int maxDepth = LOOSE_OCTREE_MAX_DEPTH)
+        : maxDepth_(maxDepth)
+    {
+        // 取立方体世界, 避免平坦地形某一轴长度为0
+        float half = std::max(0.5f, 0.5f * std::max(world.size().x, std::max(world.size().y, world.size().z)));
+        world_ = Bounds(world.centre() - glm::vec3(half), world.centre() + glm::vec3(half));
+        unsigned int total = 0;
+        for (int level = 0; level <= maxDepth_; ++level)
+        {
+            levelOffsets_.push_back(total);
+            total += 1u << (3 * level);
+        }
+        nodes_.resize(total);
+    }
+    ~LooseOctree() = default;
+    LooseOctree(const LooseOctree &) = delete;
+    LooseOctree &operator=(const LooseOctree &) = delete;
+    LooseOctree(LooseOctree &&) = default;
+    LooseOctree &operator=(LooseOctree &&) = default;
+    // 返回的句柄在remove之前一直有效
+    unsigned int insert(const Bounds &bounds, void *where)
+    {
+        unsigned int handle;
+        if (freeEntries_.empty())
+        {
+            handle = static_cast<unsigned int>(entries_.size());
+            entries_.push_back(Entry{});
+        }
+        else
+        {
+            handle = freeEntries_.back();
+            freeEntries_.pop_back();
+        }
+        entries_[handle].bounds = bounds;
+        entries_[handle].where = where;
+        link(handle, locate(bounds));
+        return handle;
+    }
+    void remove(unsigned int handle)
+    {
+        assert(handle < entries_.size() && entries_[handle].where != nullptr);
+        unlink(handle);
+        entries_[handle].where = nullptr;
+        freeEntries_.push_back(handle);
+    }
+    // 物体移动后调用, 仍在同一节点时只改包围盒
+    void update(unsigned int handle, const Bounds &bounds)
+    {
+        assert(handle < entries_.size() && entries_[handle].where != nullptr);
+        entries_[handle].bounds = bounds;
+        unsigned int node = locate(bounds);
+        if (node == entries_[handle].node)
+            return;
+        unlink(handle);
+        link(handle, node);
+    }
+    template <typename Visitor>
+    void query(const Bounds &range, Visitor &&visitor) const
+    {
+        query(0, 0, 0, 0, 0, range, visitor);
+    }
+    inline std::size_t size() const { return entries_.size() - freeEntries_.size(); }
+    inline const Bounds &getWorld() const { return world_; }
+
+private:
+    inline unsigned int index(int level, unsigned int x, unsigned int y, unsigned int z) const
+    {
+        unsigned int n = 1u << level;
+        return levelOffsets_[level] + (z * n + y) * n + x;
+    }
+    inline Bounds looseBounds(int level, unsigned int x, unsigned int y, unsigned int z) const
+    {
+        glm::vec3 cell = world_.size() / static_cast<float>(1u << level);
+        glm::vec3 min = world_.min + cell * glm::vec3(x, y, z);
+        glm::vec3 slack = cell * (LOOSE_OCTREE_LOOSENESS - 1.0f) * 0.5f;
+        return Bounds(min - slack, min + cell + slack);
+    }
+    // 选能容纳物体的最深层, 再按中心选格子; 放不下(比如出了世界范围)时逐层上移, 最终落到根节点
+    unsigned int locate(const Bounds &bounds) const
+    {
+        glm::vec3 extent = bounds.size();
+        glm::vec3 worldSize = world_.size();
+        float ratio = std::max(extent.x / worldSize.x, std::max(extent.y / worldSize.y, extent.z / worldSize.z));
+        int level = 0;
+        while (level < maxDepth_ && ratio * static_cast<float>(2u << level) <= LOOSE_OCTREE_LOOSENESS - 1.0f)
+            ++level;
+        glm::vec3 rel = (bounds.centre() - world_.min) / worldSize;
+        for (; level > 0; --level)
+        {
+            float n = static_cast<float>(1u << level);
+            auto cell = [&](float r)
+            { return static_cast<unsigned int>(glm::clamp(r * n, 0.0f, n - 1.0f)); };
+            unsigned int x = cell(rel.x), y = cell(rel.y), z = cell(rel.z);
+            if (looseBounds(level, x, y, z).contains(bounds))
+                return index(level, x, y, z);
+        }
+        return 0;
+    }
+    // 节点下标反推层和格子坐标, 用于沿父链维护population
+    void adjustPopulation(unsigned int node, int delta)
+    {
+        int level = 0;
+        while (level < maxDepth_ && node >= levelOffsets_[level + 1])
+            ++level;
+        unsigned int n = 1u << level;
+        unsigned int local = node - levelOffsets_[level];
+        unsigned int x = local % n, y = (local / n) % n, z = local / (n * n);
+        for (; level >= 0; --level, x >>= 1, y >>= 1, z >>= 1)
+            nodes_[index(level, x, y, z)].population += delta;
+    }
+    void link(unsigned int handle, unsigned int node)
+    {
+        entries_[handle].node = node;
+        entries_[handle].slot = static_cast<unsigned int>(nodes_[node].entries.size());
+        nodes_[node].entries.push_back(handle);
+        adjustPopulation(node, 1);
+    }
+    void unlink(unsigned int handle)
+    {
+        auto &entry = entries_[handle];
+        auto &entries = nodes_[entry.node].entries;
+        unsigned int moved = entries.back();
+        entries[entry.slot] = moved;
+        entries_[moved].slot = entry.slot;
+        entries.pop_back();
+        adjustPopulation(entry.node, -1);
+    }
+    // 根节点不做包围盒测试, 因为放不进任何格子的物体都挂在根上
+    template <typename Visitor>
+    void query(int level, unsigned int x, unsigned int y, unsigned int z, unsigned int idx,
+               const Bounds &range, Visitor &visitor) const
+    {
+        auto &node = nodes_[idx];
+        if (0 == node.population)
+            return;
+        if (level > 0 && !looseBounds(level, x, y, z).intersects(range))
+            return;
+        for (auto handle : node.entries)
+            if (entries_[handle].bounds.intersects(range))
+                visitor(entries_[handle].where);
+        if (level == maxDepth_)
+            return;
+        for (unsigned int i = 0; i < 8; ++i)
+        {
+            unsigned int cx = 2 * x + (i & 1), cy = 2 * y + ((i >> 1) & 1), cz = 2 * z + ((i >> 2) & 1);
+            query(level + 1, cx, cy, cz, index(level + 1, cx, cy, cz), range, visitor);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <vector>
+#include <cstddef>
+#include <fstream>
+#include <filesystem>
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 只读映射整个文件, OctreeCache与ModelCache共用; Windows上退化为一次读入
+class MappedFile
+{
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    std::vector<char> buffer_;
+#endif
+
+public:
+    MappedFile() = default;
+    ~MappedFile() { unmap(); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&) = delete;
+    MappedFile &operator=(MappedFile &&) = delete;
+    inline const char *data() const { return data_; }
+    inline std::size_t size() const { return size_; }
+#ifdef _WIN32
+    bool map(const std::filesystem::path &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+        return in.good() || in.eof();
+    }
+    void unmap()
+    {
+        buffer_.clear();
+        data_ = nullptr;
+        size_ = 0;
+    }
+#else
+    bool map(const std::filesystem::path &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *data = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                data_ = static_cast<const char *>(data);
+                size_ = static_cast<std::size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+        return nullptr != data_;
+    }
+    void unmap()
+    {
+        if (nullptr != data_)
+            ::munmap(const_cast<char *>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+#endif
+};
+
+#endif
@@ -3,16 +3,32 @@
 
 #include <iostream>
 #include <string>
+#include <stdexcept>
 #include <filesystem>
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <cstddef>
+#include <type_traits>
 #include <unordered_map>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
-#include <stb/stb_image.h>
 #include "mesh_gl.hpp"
+#include "texture_gl.hpp"
+#include "animation.hpp"
 #include "converter.hpp"
 #include "octree.hpp"
+#include "octree_cache.hpp"
+#include "model_cache.hpp"
+
+// 网格三角形的加速结构
+enum class Accelerator
+{
+    OCTREE,
+    BVH,
+};
 
 struct Hierarchy
 {
@@ -22,65 +38,74 @@ struct Hierarchy
     std::vector<Hierarchy *> children;
 };
 
+class ModelLoader;
+
 class Model
 {
+    friend class ModelLoader;
+
     std::filesystem::path path_;
+    Accelerator accelerator_;
     std::vector<Mesh> meshes_;
-    std::vector<Texture> texturesLoaded_;
+    std::vector<Texture> texturesLoaded_; // 每项在TextureRegistry里持有一次引用
     // animation attributes
     std::unordered_map<std::string, Hierarchy> bonesLoaded_;
     Hierarchy *root_ = nullptr;
+    std::vector<std::pair<std::string, Animation>> animationsLoaded_; // 按文件中的顺序, 由Animator取走
     // AABB attributes
     Octree octree_;
+    SceneBVH sceneIndex_; // 可选, 覆盖所有网格全部三角形的单个BVH, 见buildSceneIndex()
 
 public:
-    Model(const std::filesystem::path &path) : path_(path)
+    // 同步加载, 返回时GL对象都已创建; 不想阻塞渲染循环时用ModelLoader
+    // threads为处理网格的线程数, 0时取硬件线程数, 1时在调用线程上逐个处理(串行路径, 结果与并行相同)
+    Model(const std::filesystem::path &path,
+          Accelerator accelerator = Accelerator::OCTREE,
+          unsigned int threads = 0)
+        : path_(path),
+          accelerator_(accelerator)
     {
-        Assimp::Importer importer;
-        const aiScene *paiScene = importer.ReadFile(path_,
-                                                    aiProcess_CalcTangentSpace |
-                                                        aiProcess_Triangulate |
-                                                        aiProcess_GenSmoothNormals |
-                                                        aiProcess_LimitBoneWeights |
-                                                        aiProcess_JoinIdenticalVertices |
-                                                        aiProcess_ConvertToLeftHanded);
-        assert(paiScene != nullptr &&
-               !(paiScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) &&
-               paiScene->mRootNode != nullptr);
-        glm::vec3 modelMax(std::nanf(""));
-        glm::vec3 modelMin(std::nanf(""));
-        processNodes(paiScene->mRootNode, paiScene, root_, modelMin, modelMax);
-        octree_ = Octree(AABB(modelMin, modelMax));
-        for (auto &mesh : meshes_)
-            octree_.insert(AABB(mesh.getOctree().getMin(), mesh.getOctree().getMax(), &mesh));
+        std::vector<MeshData> pending;
+        prepare(pending, threads);
+        assignTextures(pending, TextureRegistry::get().acquire(getTexturePaths(pending), std::thread::hardware_concurrency()));
+        for (auto &data : pending)
+            createMesh(data);
+        finishLoad();
     }
     ~Model()
     {
         root_ = nullptr;
         for (auto &texture : texturesLoaded_)
-            glDeleteTextures(1, &texture.id);
+            TextureRegistry::get().release(texture.id);
         bonesLoaded_.clear();
+        animationsLoaded_.clear();
         texturesLoaded_.clear();
         meshes_.clear();
     }
     void swap(Model &other)
     {
         std::swap(path_, other.path_);
+        std::swap(accelerator_, other.accelerator_);
         std::swap(root_, other.root_);
         std::swap(meshes_, other.meshes_);
         std::swap(texturesLoaded_, other.texturesLoaded_);
         std::swap(bonesLoaded_, other.bonesLoaded_);
+        std::swap(animationsLoaded_, other.animationsLoaded_);
         std::swap(octree_, other.octree_);
+        std::swap(sceneIndex_, other.sceneIndex_);
     }
     Model(const Model &) = delete;
     Model &operator=(const Model &) = delete;
     Model(Model &&other)
         : path_(std::move(other.path_)),
+          accelerator_(other.accelerator_),
           root_(other.root_),
           meshes_(std::move(other.meshes_)),
           texturesLoaded_(std::move(other.texturesLoaded_)),
           bonesLoaded_(std::move(other.bonesLoaded_)),
-          octree_(std::move(other.octree_))
+          animationsLoaded_(std::move(other.animationsLoaded_)),
+          octree_(std::move(other.octree_)),
+          sceneIndex_(std::move(other.sceneIndex_))
     {
         other.root_ = nullptr;
     }
@@ -91,14 +116,213 @@ public:
         return *this;
     }
     inline std::filesystem::path getPath() const { return path_; }
+    inline Accelerator getAccelerator() const { return accelerator_; }
     inline std::unordered_map<std::string, Hierarchy> &getBonesLoaded() { return bonesLoaded_; }
+    inline std::vector<std::pair<std::string, Animation>> &getAnimationsLoaded() { return animationsLoaded_; }
     inline Hierarchy *getRootHierarchy() const { return root_; }
     inline const std::vector<Mesh> &getMeshes() const { return meshes_; }
     inline const Octree &getOctree() const { return octree_; }
+    // 把所有网格的三角形放进一个BVH, 之后的三角形查询不论地形分成多少个网格都只遍历一次
+    // 用BVH而不是八叉树: 地形多是扁平的, 八叉树按立方体细分时大量三角形跨过水平分割面而停在上层节点
+    // 与网格自己的加速结构各存一份三角形包围盒, 只给需要频繁做碰撞查询的模型(比如地面)建
+    void buildSceneIndex()
+    {
+        if (!octree_.isBuilt())
+            return;
+        std::vector<Bounds> triangles;
+        std::vector<MeshTriangle> payloads;
+        for (std::size_t m = 0; m < meshes_.size(); ++m)
+        {
+            auto &vertices = meshes_[m].getVertices();
+            auto &indices = meshes_[m].getIndices();
+            for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                auto &v0 = vertices[indices[i]].position;
+                auto &v1 = vertices[indices[i + 1]].position;
+                auto &v2 = vertices[indices[i + 2]].position;
+                triangles.emplace_back(glm::min(v0, glm::min(v1, v2)), glm::max(v0, glm::max(v1, v2)));
+                payloads.push_back(MeshTriangle{static_cast<std::uint32_t>(m), static_cast<std::uint32_t>(i / 3)});
+            }
+        }
+        sceneIndex_ = SceneBVH(std::move(triangles), std::move(payloads));
+    }
+    inline bool hasSceneIndex() const { return !sceneIndex_.empty(); }
+    inline const SceneBVH &getSceneIndex() const { return sceneIndex_; }
+    // 模型空间的三角形查询, visitor(const Mesh &mesh, std::uint32_t triangle); range可以是Bounds, Sphere或Capsule
+    // 有场景索引时一次遍历, 否则先用模型八叉树筛网格, 再查网格自己的加速结构
+    template <typename Range, typename Visitor>
+    void queryTriangles(const Range &range, Visitor &&visitor) const
+    {
+        if (hasSceneIndex())
+            sceneIndex_.query(range, [&](MeshTriangle where)
+                              { visitor(meshes_[where.mesh], where.triangle); });
+        else if (octree_.isBuilt())
+            octree_.query(range, [&](void *where)
+                          {
+                              auto mesh = static_cast<const Mesh *>(where);
+                              mesh->query(range, [&](std::uint32_t triangle)
+                                          { visitor(*mesh, triangle); }); });
+    }
+    // 模型空间的射线查询: 先用模型八叉树按距离筛网格, 再在网格内部的加速结构里找三角形
+    bool raycast(const Ray &ray, float maxDistance, RayHit &hit) const
+    {
+        if (!octree_.isBuilt())
+            return false;
+        bool found = false;
+        octree_.raycast(ray, maxDistance, [&](void *where, float &tMax)
+                        {
+                            if (static_cast<const Mesh *>(where)->raycast(ray, tMax, hit))
+                            {
+                                tMax = hit.distance;
+                                found = true;
+                            }
+                            return false; });
+        return found;
+    }
+    bool raycastAny(const Ray &ray, float maxDistance) const
+    {
+        return octree_.isBuilt() &&
+               octree_.raycast(ray, maxDistance, [&](void *where, float &)
+                               { return static_cast<const Mesh *>(where)->raycastAny(ray, maxDistance); });
+    }
+    // 模型空间的最近点查询: 模型八叉树按网格包围盒的距离由近到远访问网格, 已找到的最近距离剪掉更远的网格
+    bool closestPoint(const glm::vec3 &point, float maxDistance, ClosestHit &hit) const
+    {
+        if (!octree_.isBuilt())
+            return false;
+        bool found = false;
+        octree_.nearest(point, maxDistance * maxDistance, [&](void *where, float &maxDistance2)
+                        {
+                            if (static_cast<const Mesh *>(where)->closestPoint(point, std::sqrt(maxDistance2), hit))
+                            {
+                                maxDistance2 = hit.distance * hit.distance;
+                                found = true;
+                            } });
+        return found;
+    }
+    // 全模型的k个最近三角形, 按距离升序写入result
+    void nearest(const glm::vec3 &point, std::size_t k, float maxDistance, std::vector<ClosestHit> &result) const
+    {
+        result.clear();
+        if (!octree_.isBuilt() || 0 == k)
+            return;
+        octree_.nearest(point, maxDistance * maxDistance, [&](void *where, float &maxDistance2)
+                        {
+                            static_cast<const Mesh *>(where)->nearest(point, k, std::sqrt(maxDistance2), result);
+                            if (result.size() == k)
+                                maxDistance2 = result.back().distance * result.back().distance; });
+    }
 
 private:
+    // 一个网格在CPU上准备好的数据, 由工作线程填写; 从模型缓存读出时paiMesh为空, 顶点与索引已经就绪
+    struct MeshData
+    {
+        aiMesh *paiMesh = nullptr;
+        std::string name;
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<Texture> textures;
+        TriangleOctree octree;
+        TriangleBVH bvh;
+    };
+    // 只做不需要GL的部分, 可在工作线程上运行; 之后由ModelLoader分帧上传纹理, 创建网格, 最后finishLoad()
+    Model(const std::filesystem::path &path,
+          Accelerator accelerator,
+          std::vector<MeshData> &pending)
+        : path_(path),
+          accelerator_(accelerator)
+    {
+        prepare(pending);
+    }
+    // 层级与骨骼编号依赖遍历顺序, 串行; 各网格的CPU部分互不相关, 并行
+    void prepare(std::vector<MeshData> &pending, unsigned int threads = 0)
+    {
+        // 网格八叉树优先从缓存读取, 缓存不可用时构建完写回
+        OctreeCache cache(path_);
+        // 模型缓存有效时不经过assimp, 否则导入后写回
+        ModelCache modelCache(path_, vertexLayout(), ASSIMP_IMPORT_FLAGS);
+        bool cached = modelCache.valid() && loadCache(modelCache, pending);
+        Assimp::Importer importer;
+        if (!cached)
+        {
+            const aiScene *paiScene = importer.ReadFile(path_, ASSIMP_IMPORT_FLAGS);
+            // 导入失败在发布构建中也要报告; 经ModelLoader加载时由future转交
+            if (nullptr == paiScene || (paiScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || nullptr == paiScene->mRootNode)
+                throw std::runtime_error(importer.GetErrorString());
+            processNodes(paiScene->mRootNode, paiScene, root_, pending);
+            processAnimations(paiScene);
+        }
+        processMeshes(pending, cache, threads);
+        if (!cached)
+            saveCache(pending);
+        if (accelerator_ == Accelerator::OCTREE && cache.stale())
+        {
+            std::vector<const TriangleOctree *> octrees;
+            for (auto &data : pending)
+                octrees.push_back(&data.octree);
+            OctreeCache::save(path_, octrees);
+        }
+        meshes_.reserve(pending.size());
+    }
+    // 按网格顺序列出引用的纹理, 交给TextureRegistry批量取得
+    std::vector<std::filesystem::path> getTexturePaths(const std::vector<MeshData> &pending) const
+    {
+        std::vector<std::filesystem::path> paths;
+        for (auto &data : pending)
+            for (auto &texture : data.textures)
+                paths.push_back(path_.parent_path() / texture.path);
+        return paths;
+    }
+    void assignTextures(std::vector<MeshData> &pending, const std::vector<GLuint> &ids)
+    {
+        std::size_t next = 0;
+        for (auto &data : pending)
+            for (auto &texture : data.textures)
+            {
+                texture.id = ids[next++];
+                texturesLoaded_.push_back(texture);
+            }
+    }
+    // 在GL线程上按原顺序逐个调用
+    void createMesh(MeshData &data)
+    {
+        meshes_.emplace_back(std::move(data.vertices),
+                             std::move(data.indices),
+                             std::move(data.textures),
+                             std::move(data.octree),
+                             data.name,
+                             std::move(data.bvh));
+    }
+    // 网格都创建完后建模型八叉树; 没有网格(骨架, 只有动画的文件)时不建, getOctree().isBuilt()为false
+    void finishLoad()
+    {
+        if (meshes_.empty())
+            return;
+        glm::vec3 modelMax(std::nanf(""));
+        glm::vec3 modelMin(std::nanf(""));
+        for (auto &mesh : meshes_)
+            if (std::isnan(modelMin.x))
+            {
+                modelMin = mesh.getOctree().getMin();
+                modelMax = mesh.getOctree().getMax();
+            }
+            else
+            {
+                modelMin.x = std::min(modelMin.x, mesh.getOctree().getMin().x);
+                modelMin.y = std::min(modelMin.y, mesh.getOctree().getMin().y);
+                modelMin.z = std::min(modelMin.z, mesh.getOctree().getMin().z);
+                modelMax.x = std::max(modelMax.x, mesh.getOctree().getMax().x);
+                modelMax.y = std::max(modelMax.y, mesh.getOctree().getMax().y);
+                modelMax.z = std::max(modelMax.z, mesh.getOctree().getMax().z);
+            }
+        octree_ = Octree(Bounds(modelMin, modelMax), OctreeParams::fromCount(meshes_.size()));
+        for (auto &mesh : meshes_)
+            octree_.insert(Bounds(mesh.getOctree().getMin(), mesh.getOctree().getMax()), &mesh);
+        octree_.linearize();
+    }
+    // 建立层级并登记骨骼, 按遍历顺序记下网格
     void processNodes(aiNode *paiNode, const aiScene *paiScene,
-                      Hierarchy *&node, glm::vec3 &modelMin, glm::vec3 &modelMax)
+                      Hierarchy *&node, std::vector<MeshData> &pending)
     {
         assert(paiNode != nullptr);
         assert(paiScene != nullptr);
@@ -112,63 +336,252 @@ private:
         for (unsigned int i = 0; i < paiNode->mNumMeshes; ++i)
         {
             auto paiMesh = paiScene->mMeshes[paiNode->mMeshes[i]];
-            meshes_.push_back(processMesh(paiMesh, paiScene));
-            if (std::isnan(modelMin.x))
-            {
-                modelMin = meshes_[0].getOctree().getMin();
-                modelMax = meshes_[0].getOctree().getMax();
-            }
-            else
-            {
-                modelMin.x = std::min(modelMin.x, meshes_.back().getOctree().getMin().x);
-                modelMin.y = std::min(modelMin.y, meshes_.back().getOctree().getMin().y);
-                modelMin.z = std::min(modelMin.z, meshes_.back().getOctree().getMin().z);
-                modelMax.x = std::max(modelMax.x, meshes_.back().getOctree().getMax().x);
-                modelMax.y = std::max(modelMax.y, meshes_.back().getOctree().getMax().y);
-                modelMax.z = std::max(modelMax.z, meshes_.back().getOctree().getMax().z);
-            }
+            processBones(paiMesh);
+            pending.push_back(MeshData{paiMesh, paiMesh->mName.C_Str()});
+            pending.back().textures = processTextures(paiMesh, paiScene);
         }
         bonesLoaded_.at(nodeName).children.reserve(paiNode->mNumChildren);
         for (unsigned int i = 0; i < paiNode->mNumChildren; ++i)
         {
             Hierarchy *child = nullptr;
-            processNodes(paiNode->mChildren[i], paiScene, child, modelMin, modelMax);
+            processNodes(paiNode->mChildren[i], paiScene, child, pending);
             bonesLoaded_.at(nodeName).children.push_back(child);
         }
     }
-    Mesh processMesh(aiMesh *paiMesh, const aiScene *paiScene)
+    void processBones(aiMesh *paiMesh)
     {
         assert(paiMesh != nullptr);
+        for (unsigned int i = 0; i < paiMesh->mNumBones; ++i)
+        {
+            auto curBone = paiMesh->mBones[i];
+            std::string boneName(curBone->mName.C_Str());
+            if (!bonesLoaded_.contains(boneName))
+                bonesLoaded_.emplace(boneName,
+                                     Hierarchy{static_cast<int>(bonesLoaded_.size()),
+                                               Converter::convertMatrix2GLMFormat(curBone->mOffsetMatrix),
+                                               boneName});
+        }
+    }
+    // 工作线程按序号领取网格; 网格比核少时把多出的线程留给八叉树的批量构建
+    // maxThreads为0时取硬件线程数; 为1时不起工作线程, 八叉树也单线程构建
+    void processMeshes(std::vector<MeshData> &pending, OctreeCache &cache, unsigned int maxThreads) const
+    {
+        unsigned int cores = maxThreads > 0 ? maxThreads : std::max(1u, std::thread::hardware_concurrency());
+        unsigned int threads = static_cast<unsigned int>(std::min<std::size_t>(cores, pending.size()));
+        unsigned int buildThreads = std::max(1u, cores / std::max(1u, threads));
+        std::atomic<std::size_t> next = 0;
+        auto work = [&]
+        {
+            for (std::size_t i = next++; i < pending.size(); i = next++)
+                processMesh(i, pending[i], cache, buildThreads);
+        };
+        std::vector<std::jthread> workers;
+        for (unsigned int t = 1; t < threads; ++t)
+            workers.emplace_back(work);
+        work();
+    }
+    // 动画与网格来自同一次导入, Animator不必再读一遍文件
+    void processAnimations(const aiScene *paiScene)
+    {
         assert(paiScene != nullptr);
-        std::vector<Vertex> vertices;
-        std::vector<unsigned int> indices;
-        Octree octree = processTriangles(paiMesh, vertices, indices);
-        return Mesh(std::move(vertices),
-                    std::move(indices),
-                    processTextures(paiMesh, paiScene),
-                    std::move(octree),
-                    paiMesh->mName.C_Str());
+        animationsLoaded_.reserve(paiScene->mNumAnimations);
+        for (unsigned int i = 0; i < paiScene->mNumAnimations; ++i)
+            animationsLoaded_.emplace_back(paiScene->mAnimations[i]->mName.C_Str(), Animation(paiScene->mAnimations[i]));
     }
-    Octree processTriangles(aiMesh *paiMesh, std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    // 顶点布局的指纹(FNV-1a): 每个属性的偏移与大小, 骨骼编号与权重是否为整数, 以及sizeof(Vertex)
+    // 调换属性顺序或换类型而总大小不变时也能让旧缓存作废
+    static constexpr std::uint32_t vertexLayout()
+    {
+        const std::size_t fields[] = {
+            offsetof(Vertex, position), sizeof(Vertex::position),
+            offsetof(Vertex, normal), sizeof(Vertex::normal),
+            offsetof(Vertex, texCoords), sizeof(Vertex::texCoords),
+            offsetof(Vertex, tangent), sizeof(Vertex::tangent),
+            offsetof(Vertex, bitangent), sizeof(Vertex::bitangent),
+            offsetof(Vertex, boneIDs), sizeof(Vertex::boneIDs), std::is_integral_v<std::remove_extent_t<decltype(Vertex::boneIDs)>>,
+            offsetof(Vertex, weights), sizeof(Vertex::weights), std::is_integral_v<std::remove_extent_t<decltype(Vertex::weights)>>,
+            sizeof(Vertex)};
+        std::uint32_t hash = 2166136261u;
+        for (auto field : fields)
+        {
+            hash ^= static_cast<std::uint32_t>(field);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+    // 导入结果写进模型缓存, 下次启动不再经过assimp; 写不了时忽略
+    // 层级按编号顺序写出, 子节点存编号; 网格存名字, 顶点, 索引和纹理的类型与路径; 动画按文件中的顺序
+    void saveCache(const std::vector<MeshData> &pending) const
+    {
+        ModelCache::Writer out(path_, vertexLayout(), ASSIMP_IMPORT_FLAGS);
+        std::vector<const Hierarchy *> nodes(bonesLoaded_.size());
+        for (auto &[name, node] : bonesLoaded_)
+            nodes[node.id] = &node;
+        std::uint32_t count = static_cast<std::uint32_t>(nodes.size());
+        out.write(&count, sizeof(count));
+        for (auto node : nodes)
+        {
+            std::vector<std::int32_t> children;
+            for (auto child : node->children)
+                children.push_back(child->id);
+            out.write(node->name);
+            out.write(&node->offset, sizeof(glm::mat4));
+            out.write(children);
+        }
+        std::int32_t root = root_->id;
+        out.write(&root, sizeof(root));
+        count = static_cast<std::uint32_t>(pending.size());
+        out.write(&count, sizeof(count));
+        for (auto &data : pending)
+        {
+            out.write(data.name);
+            out.write(data.vertices);
+            out.write(data.indices);
+            count = static_cast<std::uint32_t>(data.textures.size());
+            out.write(&count, sizeof(count));
+            for (auto &texture : data.textures)
+            {
+                out.write(texture.type);
+                out.write(texture.path);
+            }
+        }
+        count = static_cast<std::uint32_t>(animationsLoaded_.size());
+        out.write(&count, sizeof(count));
+        for (auto &[name, animation] : animationsLoaded_)
+        {
+            double timing[2] = {animation.getDuration(), animation.getTicksPerSecond()};
+            out.write(name);
+            out.write(timing, sizeof(timing));
+            count = static_cast<std::uint32_t>(animation.getKeyFrames().size());
+            out.write(&count, sizeof(count));
+            for (auto &[node, keyFrame] : animation.getKeyFrames())
+            {
+                out.write(node);
+                out.write(keyFrame.getPositions());
+                out.write(keyFrame.getRotations());
+                out.write(keyFrame.getScales());
+            }
+        }
+        out.commit();
+    }
+    // 全部读成功后才写入成员, 失败时什么都不改, 改走assimp
+    bool loadCache(ModelCache &cache, std::vector<MeshData> &pending)
+    {
+        std::uint32_t count = 0;
+        if (!cache.read(&count, sizeof(count)))
+            return false;
+        std::vector<Hierarchy> nodes(count);
+        std::vector<std::vector<std::int32_t>> children(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            nodes[i].id = static_cast<int>(i);
+            if (!cache.read(nodes[i].name) || !cache.read(&nodes[i].offset, sizeof(glm::mat4)) || !cache.read(children[i]))
+                return false;
+            for (auto child : children[i])
+                if (child < 0 || child >= static_cast<std::int32_t>(count))
+                    return false;
+        }
+        std::int32_t root = -1;
+        if (!cache.read(&root, sizeof(root)) || root < 0 || root >= static_cast<std::int32_t>(count) ||
+            !cache.read(&count, sizeof(count)))
+            return false;
+        std::vector<MeshData> meshes(count);
+        for (auto &data : meshes)
+        {
+            if (!cache.read(data.name) || !cache.read(data.vertices) || !cache.read(data.indices) ||
+                !cache.read(&count, sizeof(count)))
+                return false;
+            for (auto index : data.indices)
+                if (index >= data.vertices.size())
+                    return false;
+            // 骨骼编号是层级中的序号, 空位为-1
+            for (auto &vertex : data.vertices)
+                for (int k = 0; k < MAX_BONE_INFLUENCE; ++k)
+                    if (vertex.boneIDs[k] < -1 || vertex.boneIDs[k] >= static_cast<int>(nodes.size()))
+                        return false;
+            data.textures.resize(count);
+            for (auto &texture : data.textures)
+            {
+                texture.id = 0;
+                if (!cache.read(texture.type) || !cache.read(texture.path))
+                    return false;
+            }
+        }
+        if (!cache.read(&count, sizeof(count)))
+            return false;
+        std::vector<std::pair<std::string, Animation>> animations;
+        animations.reserve(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            std::string name;
+            double timing[2] = {0.0, 0.0};
+            std::uint32_t channels = 0;
+            if (!cache.read(name) || !cache.read(timing, sizeof(timing)) || 0.0 == timing[1] ||
+                !cache.read(&channels, sizeof(channels)))
+                return false;
+            std::unordered_map<std::string, KeyFrame> keyFrames;
+            for (std::uint32_t c = 0; c < channels; ++c)
+            {
+                std::string node;
+                std::vector<KeyPosition> positions;
+                std::vector<KeyRotation> rotations;
+                std::vector<KeyScale> scales;
+                // KeyFrame直接取[0], 空的关键帧数组只能来自损坏的缓存
+                if (!cache.read(node) || !cache.read(positions) || !cache.read(rotations) || !cache.read(scales) ||
+                    positions.empty() || rotations.empty() || scales.empty())
+                    return false;
+                keyFrames.emplace(node, KeyFrame(std::move(positions), std::move(rotations), std::move(scales)));
+            }
+            animations.emplace_back(name, Animation(timing[0], timing[1], std::move(keyFrames)));
+        }
+        std::vector<Hierarchy *> byId(nodes.size());
+        for (auto &node : nodes)
+        {
+            auto name = node.name;
+            byId[node.id] = &bonesLoaded_.emplace(name, std::move(node)).first->second;
+        }
+        for (std::size_t i = 0; i < byId.size(); ++i)
+            for (auto child : children[i])
+                byId[i]->children.push_back(byId[child]);
+        root_ = byId[root];
+        animationsLoaded_ = std::move(animations);
+        pending = std::move(meshes);
+        return true;
+    }
+    // 只做CPU上的工作, 在工作线程上运行: bonesLoaded_只读, 缓存按网格序号读取
+    void processMesh(std::size_t mesh, MeshData &data, OctreeCache &cache, unsigned int buildThreads) const
+    {
+        if (data.paiMesh != nullptr)
+            processVertices(data.paiMesh, data.vertices, data.indices);
+        std::vector<Bounds> triangles;
+        data.octree = processTriangles(data.vertices, data.indices, triangles);
+        if (accelerator_ == Accelerator::BVH)
+        {
+            std::vector<std::uint32_t> payloads(triangles.size()); // 载荷为三角形序号
+            std::iota(payloads.begin(), payloads.end(), 0u);
+            data.bvh = TriangleBVH(std::move(triangles), std::move(payloads));
+        }
+        else
+        {
+            OctreeParams params = cache.getParams(triangles.size());
+            if (!cache.load(mesh, data.octree, params, data.octree.getGlobalAABB(), triangles.size()))
+            {
+                std::vector<std::uint32_t> payloads(triangles.size());
+                std::iota(payloads.begin(), payloads.end(), 0u);
+                data.octree = TriangleOctree(data.octree.getGlobalAABB(), params);
+                data.octree.bulkBuild(triangles, payloads, buildThreads);
+            }
+        }
+        if (!data.octree.isLinear())
+            data.octree.linearize();
+    }
+    void processVertices(aiMesh *paiMesh, std::vector<Vertex> &vertices, std::vector<unsigned int> &indices) const
     {
         assert(paiMesh != nullptr);
-        glm::vec3 meshMax;
-        glm::vec3 meshMin;
         vertices.resize(paiMesh->mNumVertices);
         for (unsigned int i = 0; i < paiMesh->mNumVertices; ++i)
         {
             vertices[i].position = Converter::getGLMVec(paiMesh->mVertices[i]);
-            if (i == 0)
-                meshMin = meshMax = vertices[i].position;
-            else
-            {
-                meshMin.x = std::min(meshMin.x, vertices[i].position.x);
-                meshMin.y = std::min(meshMin.y, vertices[i].position.y);
-                meshMin.z = std::min(meshMin.z, vertices[i].position.z);
-                meshMax.x = std::max(meshMax.x, vertices[i].position.x);
-                meshMax.y = std::max(meshMax.y, vertices[i].position.y);
-                meshMax.z = std::max(meshMax.z, vertices[i].position.z);
-            }
             if (paiMesh->HasNormals())
                 vertices[i].normal = Converter::getGLMVec(paiMesh->mNormals[i]);
             else
@@ -196,12 +609,7 @@ private:
         for (unsigned int i = 0; i < paiMesh->mNumBones; ++i)
         {
             auto curBone = paiMesh->mBones[i];
-            std::string boneName(curBone->mName.C_Str());
-            if (!bonesLoaded_.contains(boneName))
-                bonesLoaded_.emplace(boneName,
-                                     Hierarchy{static_cast<int>(bonesLoaded_.size()),
-                                               Converter::convertMatrix2GLMFormat(curBone->mOffsetMatrix),
-                                               boneName});
+            int boneId = bonesLoaded_.at(curBone->mName.C_Str()).id; // processBones已登记
             for (unsigned int j = 0; j < curBone->mNumWeights; ++j)
             {
                 auto curWeight = curBone->mWeights[j];
@@ -209,7 +617,7 @@ private:
                 for (int k = 0; k < MAX_BONE_INFLUENCE; ++k)
                     if (vertices[vertexId].boneIDs[k] == -1)
                     {
-                        vertices[vertexId].boneIDs[k] = bonesLoaded_[boneName].id;
+                        vertices[vertexId].boneIDs[k] = boneId;
                         vertices[vertexId].weights[k] = curWeight.mWeight;
                         break;
                     }
@@ -231,15 +639,35 @@ private:
         //                 break;
         // }
         indices.reserve(paiMesh->mNumFaces * 3);
-        Octree octree(AABB(meshMin, meshMax));
+        for (unsigned int i = 0; i < paiMesh->mNumFaces; ++i)
+            for (unsigned int j = 0; j < 3; ++j)
+                indices.push_back(paiMesh->mFaces[i].mIndices[j]);
+    }
+    // 返回只含网格包围盒的八叉树, 三角形包围盒放进triangles由调用者决定插入哪种加速结构
+    TriangleOctree processTriangles(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, std::vector<Bounds> &triangles) const
+    {
+        glm::vec3 meshMax(0.0f);
+        glm::vec3 meshMin(0.0f);
+        for (std::size_t i = 0; i < vertices.size(); ++i)
+            if (i == 0)
+                meshMin = meshMax = vertices[i].position;
+            else
+            {
+                meshMin.x = std::min(meshMin.x, vertices[i].position.x);
+                meshMin.y = std::min(meshMin.y, vertices[i].position.y);
+                meshMin.z = std::min(meshMin.z, vertices[i].position.z);
+                meshMax.x = std::max(meshMax.x, vertices[i].position.x);
+                meshMax.y = std::max(meshMax.y, vertices[i].position.y);
+                meshMax.z = std::max(meshMax.z, vertices[i].position.z);
+            }
+        triangles.reserve(indices.size() / 3);
         glm::vec3 TriangleMax;
         glm::vec3 TriangleMin;
-        for (unsigned int i = 0; i < paiMesh->mNumFaces; ++i)
+        for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
         {
-            for (unsigned int j = 0; j < 3; ++j)
+            for (std::size_t j = 0; j < 3; ++j)
             {
-                auto idx = paiMesh->mFaces[i].mIndices[j];
-                indices.push_back(idx);
+                auto idx = indices[i + j];
                 if (j == 0)
                     TriangleMin = TriangleMax = vertices[idx].position;
                 else
@@ -252,11 +680,12 @@ private:
                     TriangleMax.z = std::max(TriangleMax.z, vertices[idx].position.z);
                 }
             }
-            octree.insert(AABB(TriangleMin, TriangleMax, indices.data() + i * 3));
+            triangles.emplace_back(TriangleMin, TriangleMax);
         }
-        return std::move(octree);
+        return TriangleOctree(Bounds(meshMin, meshMax));
     }
-    std::vector<Texture> processTextures(aiMesh *paiMesh, const aiScene *paiScene)
+    // 只读材质, 纹理的id由assignTextures()填写
+    std::vector<Texture> processTextures(aiMesh *paiMesh, const aiScene *paiScene) const
     {
         assert(paiMesh != nullptr);
         assert(paiScene != nullptr);
@@ -268,7 +697,7 @@ private:
         loadMaterialTextures(textures, paiMaterial, aiTextureType_AMBIENT, "texture_height");
         return textures;
     }
-    void loadMaterialTextures(std::vector<Texture> &textures, aiMaterial *paiMaterial, aiTextureType paiTextureType, const std::string &typeName)
+    void loadMaterialTextures(std::vector<Texture> &textures, aiMaterial *paiMaterial, aiTextureType paiTextureType, const std::string &typeName) const
     {
         assert(paiMaterial != nullptr);
         unsigned int num = paiMaterial->GetTextureCount(paiTextureType);
@@ -277,58 +706,12 @@ private:
         {
             aiString path;
             paiMaterial->GetTexture(paiTextureType, i, &path);
-            bool skip = false;
-            for (unsigned int j = 0; j < texturesLoaded_.size(); ++j)
-                if (std::strcmp(texturesLoaded_[j].path.c_str(), path.C_Str()) == 0)
-                {
-                    textures.push_back(texturesLoaded_[j]);
-                    skip = true;
-                    break;
-                }
-            if (!skip)
-            {
-                Texture texture;
-                texture.id = TextureFromFile(path.C_Str());
-                texture.type = typeName;
-                texture.path = path.C_Str();
-                textures.push_back(texture);
-                texturesLoaded_.push_back(texture);
-            }
-        }
-    }
-    unsigned int TextureFromFile(const char *filename)
-    {
-        assert(filename != nullptr);
-        std::string path(path_.parent_path() / filename);
-        unsigned int textureID;
-        glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
-        int width, height, comp;
-        unsigned char *pImage = stbi_load(path.c_str(), &width, &height, &comp, 0);
-        assert(pImage != nullptr);
-        GLenum format;
-        switch (comp)
-        {
-        case 1:
-            format = GL_RED;
-            break;
-        case 3:
-            format = GL_RGB;
-            break;
-        case 4:
-            format = GL_RGBA;
-            break;
-        default:
-            assert(false);
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = path.C_Str();
+            textures.push_back(texture);
         }
-        glTextureStorage2D(textureID, 1 + static_cast<int>(std::log2(std::max(width, height))), format == GL_RGBA ? GL_RGBA8 : GL_RGB8, width, height);
-        glTextureSubImage2D(textureID, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, pImage);
-        glGenerateTextureMipmap(textureID);
-        glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        stbi_image_free(pImage);
-        return textureID;
     }
 };
 
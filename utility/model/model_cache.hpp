@@ -0,0 +1,165 @@
+#ifndef MODEL_CACHE_HPP
+#define MODEL_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <type_traits>
+#include "mapped_file.hpp"
+
+#define MODEL_CACHE_MAGIC 0x444d334du // "M3MD"
+#define MODEL_CACHE_VERSION 3u        // 布局有变化时加1, 旧缓存自动作废
+#define MODEL_CACHE_EXTENSION ".model"
+
+// 模型导入结果(顶点, 索引, 层级, 动画)的缓存, 写在资源文件旁边(boxes.fbx -> boxes.fbx.model), 以只读mmap方式读回
+// 文件头: magic, version, 顶点布局, assimp导入选项, 资源修改时间, 资源路径长度与路径; 之后的内容由Model::saveCache()按顺序写出
+// 顶点布局与导入选项由调用方给出(Model::vertexLayout(), ASSIMP_IMPORT_FLAGS), 改了其中之一时旧缓存作废, 不必记得改版本号
+// 字符串存为长度加字节, 数组存为个数加原始内存, 只在同一平台同一构建之间通用
+class ModelCache
+{
+    MappedFile file_;
+    const char *cursor_ = nullptr;
+    const char *end_ = nullptr;
+    bool valid_ = false;
+
+public:
+    // 打开并校验文件头; 文件不存在, 版本, 顶点布局或导入选项不符, 或资源已被修改时valid()为false
+    ModelCache(const std::filesystem::path &asset, std::uint32_t vertexLayout, std::uint32_t importFlags)
+    {
+        std::error_code ec;
+        auto cache = getPath(asset);
+        if (!std::filesystem::exists(cache, ec) || !file_.map(cache))
+            return;
+        cursor_ = file_.data();
+        end_ = file_.data() + file_.size();
+        std::uint32_t magic = 0, version = 0, layout = 0, flags = 0;
+        std::int64_t stamp = 0;
+        std::string path;
+        valid_ = read(&magic, sizeof(magic)) && MODEL_CACHE_MAGIC == magic &&
+                 read(&version, sizeof(version)) && MODEL_CACHE_VERSION == version &&
+                 read(&layout, sizeof(layout)) && vertexLayout == layout &&
+                 read(&flags, sizeof(flags)) && importFlags == flags &&
+                 read(&stamp, sizeof(stamp)) && getStamp(asset) == stamp &&
+                 read(path) && path == asset.generic_string();
+    }
+    ~ModelCache() = default;
+    ModelCache(const ModelCache &) = delete;
+    ModelCache &operator=(const ModelCache &) = delete;
+    ModelCache(ModelCache &&) = delete;
+    ModelCache &operator=(ModelCache &&) = delete;
+    inline bool valid() const { return valid_; }
+    // 按写入顺序读出, 越界时返回false
+    bool read(void *data, std::size_t size)
+    {
+        if (static_cast<std::size_t>(end_ - cursor_) < size)
+            return false;
+        std::memcpy(data, cursor_, size);
+        cursor_ += size;
+        return true;
+    }
+    bool read(std::string &text)
+    {
+        std::uint32_t length = 0;
+        if (!read(&length, sizeof(length)) || static_cast<std::size_t>(end_ - cursor_) < length)
+            return false;
+        text.assign(cursor_, length);
+        cursor_ += length;
+        return true;
+    }
+    template <typename T>
+    bool read(std::vector<T> &items)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::uint64_t count = 0;
+        if (!read(&count, sizeof(count)) || static_cast<std::size_t>(end_ - cursor_) / sizeof(T) < count)
+            return false;
+        items.resize(count);
+        return read(items.data(), count * sizeof(T));
+    }
+    static inline std::filesystem::path getPath(const std::filesystem::path &asset)
+    {
+        auto cache = asset;
+        cache += MODEL_CACHE_EXTENSION;
+        return cache;
+    }
+
+    // 写临时文件, commit()时改名; 中途失败的缓存不会留下
+    class Writer
+    {
+        std::filesystem::path cache_;
+        std::filesystem::path temp_;
+        std::ofstream out_;
+
+    public:
+        Writer(const std::filesystem::path &asset, std::uint32_t vertexLayout, std::uint32_t importFlags)
+            : cache_(getPath(asset)),
+              temp_(cache_.string() + ".tmp"),
+              out_(temp_, std::ios::binary | std::ios::trunc)
+        {
+            std::uint32_t header[4] = {MODEL_CACHE_MAGIC, MODEL_CACHE_VERSION, vertexLayout, importFlags};
+            std::int64_t stamp = getStamp(asset);
+            write(header, sizeof(header));
+            write(&stamp, sizeof(stamp));
+            write(asset.generic_string());
+        }
+        ~Writer()
+        {
+            std::error_code ec;
+            if (out_.is_open())
+            {
+                out_.close();
+                std::filesystem::remove(temp_, ec);
+            }
+        }
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+        Writer(Writer &&) = delete;
+        Writer &operator=(Writer &&) = delete;
+        inline void write(const void *data, std::size_t size)
+        {
+            out_.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        }
+        void write(const std::string &text)
+        {
+            std::uint32_t length = static_cast<std::uint32_t>(text.size());
+            write(&length, sizeof(length));
+            write(text.data(), text.size());
+        }
+        template <typename T>
+        void write(const std::vector<T> &items)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            std::uint64_t count = items.size();
+            write(&count, sizeof(count));
+            write(items.data(), items.size() * sizeof(T));
+        }
+        // 写不了(比如只读目录)时返回false
+        bool commit()
+        {
+            std::error_code ec;
+            out_.close();
+            if (!out_)
+            {
+                std::filesystem::remove(temp_, ec);
+                return false;
+            }
+            std::filesystem::rename(temp_, cache_, ec);
+            if (ec)
+                std::filesystem::remove(temp_, ec);
+            return !ec;
+        }
+    };
+
+private:
+    static inline std::int64_t getStamp(const std::filesystem::path &asset)
+    {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(asset, ec);
+        return ec ? 0 : static_cast<std::int64_t>(time.time_since_epoch().count());
+    }
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef MODEL_LOADER_HPP
+#define MODEL_LOADER_HPP
+
+#include <deque>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <future>
+#include <optional>
+#include <filesystem>
+#include "model.hpp"
+
+#define MODEL_LOADER_BUDGET_MS 4.0 // 每帧用于上传的默认时间, 60帧时约为一帧的1/4
+
+// 不阻塞渲染循环的模型加载: load()立即返回future, 导入与网格的CPU部分在工作线程上完成
+// 之后GL线程每帧调用update(), 在预算时间内逐张上传纹理, 逐个创建网格, 全部完成后future就绪
+// 粒度是一张纹理或一个网格, 单个很大的上传仍可能超出预算
+// update()会调用GL, 只能在上下文线程上使用
+class ModelLoader
+{
+    enum class Stage
+    {
+        PARSING,
+        TEXTURES,
+        MESHES,
+        DONE,
+    };
+    struct Job
+    {
+        std::unique_ptr<Model> model;
+        std::vector<Model::MeshData> pending;
+        Stage stage = Stage::PARSING;
+        std::optional<TextureRegistry::Batch> textures;
+        std::size_t nextMesh = 0;
+        std::promise<Model> promise;
+        std::future<void> prepared; // 放在最后, 析构时先等工作线程结束
+
+        // 在纹理阶段中途被销毁时交还已取得的引用; 之后的阶段由Model的析构释放
+        ~Job()
+        {
+            if (textures)
+                TextureRegistry::get().cancel(*textures);
+        }
+    };
+    std::deque<std::unique_ptr<Job>> jobs_;
+
+public:
+    ModelLoader() = default;
+    ~ModelLoader() = default;
+    ModelLoader(const ModelLoader &) = delete;
+    ModelLoader &operator=(const ModelLoader &) = delete;
+    ModelLoader(ModelLoader &&) = default;
+    ModelLoader &operator=(ModelLoader &&) = default;
+    // 结果与同步构造的Model相同; 导入时抛出的异常由future转交, 加载器先于完成被销毁时future得到broken_promise
+    std::future<Model> load(const std::filesystem::path &path,
+                            Accelerator accelerator = Accelerator::OCTREE)
+    {
+        auto job = std::make_unique<Job>();
+        auto future = job->promise.get_future();
+        job->prepared = std::async(std::launch::async, [job = job.get(), path, accelerator]
+                                   { job->model.reset(new Model(path, accelerator, job->pending)); });
+        jobs_.push_back(std::move(job));
+        return future;
+    }
+    // 每帧调用一次, 按提交顺序推进各加载任务, 用时超过budgetMs后停下; 返回尚未完成的任务数
+    std::size_t update(double budgetMs = MODEL_LOADER_BUDGET_MS)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto elapsed = [start]
+        { return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count(); };
+        for (auto it = jobs_.begin(); it != jobs_.end() && elapsed() < budgetMs;)
+        {
+            while (elapsed() < budgetMs && step(**it))
+                ;
+            if (Stage::DONE == (*it)->stage)
+                it = jobs_.erase(it);
+            else
+                ++it;
+        }
+        return jobs_.size();
+    }
+    inline std::size_t getPending() const { return jobs_.size(); }
+
+private:
+    // 推进一步; 在等工作线程(导入或解码)或任务已完成时返回false
+    static bool step(Job &job)
+    {
+        auto &registry = TextureRegistry::get();
+        switch (job.stage)
+        {
+        case Stage::PARSING:
+            if (std::future_status::ready != job.prepared.wait_for(std::chrono::seconds(0)))
+                return false;
+            try
+            {
+                job.prepared.get();
+            }
+            catch (...)
+            {
+                job.promise.set_exception(std::current_exception());
+                job.pending.clear();
+                job.stage = Stage::DONE;
+                return false;
+            }
+            job.textures.emplace(registry.begin(job.model->getTexturePaths(job.pending), std::thread::hardware_concurrency()));
+            job.stage = Stage::TEXTURES;
+            return true;
+        case Stage::TEXTURES:
+            if (!job.textures->done())
+                return registry.step(*job.textures, false);
+            job.model->assignTextures(job.pending, registry.finish(*job.textures));
+            job.textures.reset();
+            job.stage = Stage::MESHES;
+            return true;
+        case Stage::MESHES:
+            if (job.nextMesh < job.pending.size())
+            {
+                job.model->createMesh(job.pending[job.nextMesh++]);
+                return true;
+            }
+            job.model->finishLoad();
+            job.pending.clear();
+            job.promise.set_value(std::move(*job.model));
+            job.model.reset();
+            job.stage = Stage::DONE;
+            return true;
+        case Stage::DONE:
+            return false;
+        }
+        return false;
+    }
+};
+
+#endif
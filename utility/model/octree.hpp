@@ -2,121 +2,215 @@
 #define OCTREE_HPP
 
 #include <vector>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <type_traits>
 #include <glm/glm.hpp>
 #include "aabb.hpp"
+#include "bounds_soa.hpp"
+#include "frustum.hpp"
+#include "octree_stats.hpp"
 
 #define OCTREE_MAX_DEPTH 5
 #define OCTREE_MAX_OBJECTS 4
+#define OCTREE_BULK_MIN_CHUNK 16384 // 批量构建时每个线程至少处理的物体数
+#define OCTREE_DEPTH_LIMIT 10        // Morton码每轴10位
+#define OCTREE_BATCH_WIDTH 64        // 批量查询一组的范围数(一个64位掩码)
+#define OCTREE_POOL_BLOCK 4096       // 节点池的首块字节数, 之后每块按倍数增长
 
-class Octree
+// 每棵八叉树的构建参数
+struct OctreeParams
 {
-    struct OctreeNode : public AABB
+    int maxDepth = OCTREE_MAX_DEPTH;
+    int maxObjects = OCTREE_MAX_OBJECTS;
+
+    // 按物体数估算深度: 满树叶子平均不超过maxObjects个物体的最小深度, 至少1层
+    static OctreeParams fromCount(std::size_t count, int maxObjects = OCTREE_MAX_OBJECTS)
+    {
+        OctreeParams params{1, maxObjects};
+        for (std::size_t capacity = 8 * static_cast<std::size_t>(maxObjects);
+             capacity < count && params.maxDepth < OCTREE_DEPTH_LIMIT;
+             capacity *= 8)
+            ++params.maxDepth;
+        return params;
+    }
+    bool operator==(const OctreeParams &) const = default;
+};
+
+// Payload为物体的载荷, 按值存放: 模型八叉树存网格指针(void *), 网格八叉树存三角形序号(std::uint32_t)
+// 序号不依赖indices的地址, 树可以随意移动, 序列化与在多个网格实例间共享
+template <typename Payload = void *>
+class BasicOctree
+{
+    // 指针树的节点从所属八叉树的节点池(单调分配器)里按8个一块分配, 建树期间不释放, 池里没有浪费
+    // 物体数组会反复扩容, 用普通的std::vector; 放进单调池时旧数组都留在池里
+    struct OctreeNode : public Bounds
     {
-        std::vector<AABB> objects;
+        std::vector<Bounds> objects;
+        std::vector<Payload> payloads; // 与objects一一对应
         OctreeNode *children[8] = {nullptr};
+        std::pmr::memory_resource *pool; // 子节点从这里分配
         int depth = 0;
         int maxDepth;
         int maxObjects;
 
-        OctreeNode(AABB &&aabb,
+        OctreeNode(const Bounds &bounds,
                    int depth,
-                   int maxDepth = OCTREE_MAX_DEPTH,
-                   int maxObjects = OCTREE_MAX_OBJECTS)
-            : AABB(std::move(aabb)),
+                   int maxDepth,
+                   int maxObjects,
+                   std::pmr::memory_resource *pool)
+            : Bounds(bounds),
+              pool(pool),
               depth(depth),
               maxDepth(maxDepth),
               maxObjects(maxObjects) {}
-        ~OctreeNode()
-        {
-            for (auto &child : children)
-                delete child;
-        }
         OctreeNode(const OctreeNode &) = delete;
         OctreeNode &operator=(const OctreeNode &) = delete;
-        OctreeNode(OctreeNode &&other)
-            : AABB(std::move(other)),
-              objects(std::move(other.objects)),
-              depth(other.depth),
-              maxDepth(other.maxDepth),
-              maxObjects(other.maxObjects)
-        {
-            for (int i = 0; i < 8; ++i)
-            {
-                children[i] = other.children[i];
-                other.children[i] = nullptr;
-            }
-        }
-        OctreeNode &operator=(OctreeNode &&other)
-        {
-            depth = other.depth;
-            maxDepth = other.maxDepth;
-            maxObjects = other.maxObjects;
-            AABB::min = other.min;
-            AABB::max = other.max;
-            AABB::centre = other.centre;
-            AABB::size = other.size;
-            AABB::where = other.where;
-            objects = std::move(other.objects);
-            for (int i = 0; i < 8; ++i)
-            {
-                children[i] = other.children[i];
-                other.children[i] = nullptr;
-            }
-            return *this;
-        }
-        void insert(const AABB &obj)
+        void insert(const Bounds &obj, Payload where)
         {
             if (!intersects(obj))
                 return;
             if (isLeaf())
             {
                 objects.push_back(obj);
+                payloads.push_back(where);
                 if (objects.size() > maxObjects && depth < maxDepth)
                 {
                     subdivide();
-                    std::vector<AABB> remainingObjects;
-                    for (const auto &existingObj : objects)
+                    std::vector<Bounds> remainingObjects;
+                    std::vector<Payload> remainingPayloads;
+                    for (std::size_t i = 0; i < objects.size(); ++i)
                     {
                         bool assigned = false;
                         for (auto &child : children)
-                            if (child && child->contains(existingObj))
+                            if (child && child->contains(objects[i]))
                             {
-                                child->insert(existingObj);
+                                child->insert(objects[i], payloads[i]);
                                 assigned = true;
                                 break;
                             }
                         if (!assigned)
-                            remainingObjects.push_back(existingObj);
+                        {
+                            remainingObjects.push_back(objects[i]);
+                            remainingPayloads.push_back(payloads[i]);
+                        }
                     }
                     objects = std::move(remainingObjects);
+                    payloads = std::move(remainingPayloads);
                 }
                 return;
             }
             for (auto &child : children)
                 if (child && child->contains(obj))
                 {
-                    child->insert(obj);
+                    child->insert(obj, where);
                     return;
                 }
             objects.push_back(obj);
+            payloads.push_back(where);
         }
-        void query(const AABB &range, std::vector<AABB> &result) const
+        template <typename Visitor>
+        void query(const Bounds &range, Visitor &visitor) const
         {
             if (!intersects(range))
                 return;
-            for (const auto &obj : objects)
-                if (obj.intersects(range))
-                    result.push_back(obj);
+            for (std::size_t i = 0; i < objects.size(); ++i)
+                if (objects[i].intersects(range))
+                    visitor(objects[i], payloads[i]);
             if (!isLeaf())
                 for (const auto &child : children)
                     if (child)
-                        child->query(range, result);
+                        child->query(range, visitor);
+        }
+        // Shape为Sphere或Capsule: 先用外接盒快速排除, 再按真实距离判断
+        template <typename Shape, typename Visitor>
+        void queryShape(const Shape &shape, const Bounds &range, Visitor &visitor) const
+        {
+            if (!intersects(range) || !shape.intersects(*this))
+                return;
+            for (std::size_t i = 0; i < objects.size(); ++i)
+                if (objects[i].intersects(range) && shape.intersects(objects[i]))
+                    visitor(payloads[i]);
+            if (!isLeaf())
+                for (const auto &child : children)
+                    if (child)
+                        child->queryShape(shape, range, visitor);
+        }
+        // 完全在视锥内的子树不再做平面测试
+        template <typename Visitor>
+        void cull(const Frustum &frustum, bool inside, Visitor &visitor) const
+        {
+            if (!inside)
+            {
+                auto side = frustum.classify(*this);
+                if (side == Frustum::Side::OUTSIDE)
+                    return;
+                inside = side == Frustum::Side::INSIDE;
+            }
+            for (std::size_t i = 0; i < objects.size(); ++i)
+                if (inside || frustum.intersects(objects[i]))
+                    visitor(payloads[i]);
+            if (!isLeaf())
+                for (const auto &child : children)
+                    if (child)
+                        child->cull(frustum, inside, visitor);
+        }
+        // 调用前已确认本节点与射线相交; visitor返回true时整个查询结束
+        template <typename Visitor>
+        bool raycast(const Ray &ray, float &tMax, Visitor &visitor) const
+        {
+            float tEnter;
+            for (std::size_t i = 0; i < objects.size(); ++i)
+                if (objects[i].intersectRay(ray, tMax, tEnter) && visitor(payloads[i], tMax))
+                    return true;
+            if (isLeaf())
+                return false;
+            std::pair<float, const OctreeNode *> order[8];
+            int count = 0;
+            for (const auto &child : children)
+                if (child && child->intersectRay(ray, tMax, tEnter))
+                    order[count++] = {tEnter, child};
+            std::sort(order, order + count, [](const auto &a, const auto &b)
+                      { return a.first < b.first; });
+            for (int i = 0; i < count; ++i)
+                if (order[i].first <= tMax && order[i].second->raycast(ray, tMax, visitor))
+                    return true;
+            return false;
+        }
+        // 调用前已确认本节点到point的距离平方不超过maxDistance2
+        // 先下沉到离point近的孩子把maxDistance2收紧, 再测本层跨界的物体, 它们多数随之被剪掉
+        template <typename Visitor>
+        void nearest(const glm::vec3 &point, float &maxDistance2, Visitor &visitor) const
+        {
+            if (!isLeaf())
+            {
+                std::pair<float, const OctreeNode *> order[8];
+                int count = 0;
+                for (const auto &child : children)
+                    if (child)
+                        if (float d2 = child->distance2(point); d2 <= maxDistance2)
+                            order[count++] = {d2, child};
+                std::sort(order, order + count, [](const auto &a, const auto &b)
+                          { return a.first < b.first; });
+                for (int i = 0; i < count; ++i)
+                    if (order[i].first <= maxDistance2)
+                        order[i].second->nearest(point, maxDistance2, visitor);
+            }
+            for (std::size_t i = 0; i < objects.size(); ++i)
+                if (objects[i].distance2(point) <= maxDistance2)
+                    visitor(payloads[i], maxDistance2);
         }
         inline void print() const
         {
             std::cout << "\ndepth:" << depth << std::endl;
-            AABB::print();
+            Bounds::print();
             std::cout << "\nobjects:" << std::endl;
             for (auto &obj : objects)
                 obj.print();
@@ -125,11 +219,14 @@ class Octree
                 if (child)
                     child->print();
         }
+        inline bool isLeaf() const { return nullptr == children[0]; }
 
     private:
-        inline bool isLeaf() const { return nullptr == children[0]; }
+        // 8个子节点一次从池里取出, 连续存放
         void subdivide()
         {
+            auto block = static_cast<OctreeNode *>(pool->allocate(8 * sizeof(OctreeNode), alignof(OctreeNode)));
+            glm::vec3 centre = Bounds::centre();
             for (int i = 0; i < 8; ++i)
             {
                 glm::vec3 newMin = glm::vec3(
@@ -140,70 +237,502 @@ class Octree
                     (i & 1) ? max.x : centre.x,
                     (i & 2) ? max.y : centre.y,
                     (i & 4) ? max.z : centre.z);
-                children[i] = new OctreeNode(AABB(newMin, newMax), depth + 1, maxDepth, maxObjects);
+                children[i] = new (block + i) OctreeNode(Bounds(newMin, newMax), depth + 1, maxDepth, maxObjects, pool);
             }
         }
     };
+    // 线性布局: 节点按广度优先连续存放, 同一父节点的8个子节点相邻
+    // 节点与物体的包围盒都按分量分开存放, 8个子节点或一批物体可以一次测完
+    struct LinearNode
+    {
+        unsigned int firstChild = 0; // 0表示叶子(根节点不会是任何节点的子节点)
+        unsigned int firstObject = 0;
+        unsigned int objectCount = 0;
+    };
+    Bounds bounds_;
+    OctreeParams params_;
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> pool_; // 指针树的节点池, 树移动时池不动
     OctreeNode *root_ = nullptr;
+    std::vector<LinearNode> nodes_;
+    BoundsSoA nodeBounds_;         // 与nodes_一一对应
+    BoundsSoA objects_;            // 末尾有补齐, 见BoundsSoA::pad()
+    std::vector<Payload> payloads_; // 与objects_一一对应
 
 public:
-    Octree(AABB &&aabb = AABB(glm::vec3(std::nanf("")), glm::vec3(std::nanf(""))))
+    BasicOctree(const Bounds &bounds = Bounds(glm::vec3(std::nanf("")), glm::vec3(std::nanf(""))),
+           const OctreeParams &params = OctreeParams())
+        : bounds_(bounds),
+          params_(params)
     {
-        if (std::isnan(aabb.min.x))
+        assert(params.maxDepth >= 0 && params.maxDepth <= OCTREE_DEPTH_LIMIT && params.maxObjects > 0);
+        if (std::isnan(bounds.min.x))
             return;
-        root_ = new OctreeNode(std::move(aabb), 0);
+        pool_ = std::make_unique<std::pmr::monotonic_buffer_resource>(OCTREE_POOL_BLOCK);
+        root_ = new (pool_->allocate(sizeof(OctreeNode), alignof(OctreeNode)))
+            OctreeNode(bounds, 0, params.maxDepth, params.maxObjects, pool_.get());
     }
-    ~Octree() { delete root_; }
-    Octree(const Octree &) = delete;
-    Octree &operator=(const Octree &) = delete;
-    Octree(Octree &&other) : root_(other.root_) { other.root_ = nullptr; }
-    Octree &operator=(Octree &&other)
+    ~BasicOctree() { releaseNodes(); }
+    BasicOctree(const BasicOctree &) = delete;
+    BasicOctree &operator=(const BasicOctree &) = delete;
+    BasicOctree(BasicOctree &&other)
+        : bounds_(other.bounds_),
+          params_(other.params_),
+          pool_(std::move(other.pool_)),
+          root_(other.root_),
+          nodes_(std::move(other.nodes_)),
+          nodeBounds_(std::move(other.nodeBounds_)),
+          objects_(std::move(other.objects_)),
+          payloads_(std::move(other.payloads_))
     {
-        root_ = other.root_;
         other.root_ = nullptr;
+    }
+    BasicOctree &operator=(BasicOctree &&other)
+    {
+        if (this != &other)
+        {
+            releaseNodes();
+            bounds_ = other.bounds_;
+            params_ = other.params_;
+            pool_ = std::move(other.pool_);
+            root_ = other.root_;
+            nodes_ = std::move(other.nodes_);
+            nodeBounds_ = std::move(other.nodeBounds_);
+            objects_ = std::move(other.objects_);
+            payloads_ = std::move(other.payloads_);
+            other.root_ = nullptr;
+        }
         return *this;
     }
-    inline void insert(const AABB &obj)
+    // 把指针树展开成连续数组并释放所有节点, 之后只能查询不能再插入; 没有建树时(如没有网格的模型)什么都不做
+    void linearize()
+    {
+        if (nullptr == root_)
+            return;
+        nodes_.clear();
+        nodeBounds_.clear();
+        objects_.clear();
+        payloads_.clear();
+        std::vector<const OctreeNode *> order{root_};
+        nodes_.push_back(LinearNode{});
+        nodeBounds_.push_back(*root_);
+        for (std::size_t i = 0; i < order.size(); ++i)
+        {
+            auto node = order[i];
+            nodes_[i].firstObject = static_cast<unsigned int>(payloads_.size());
+            nodes_[i].objectCount = static_cast<unsigned int>(node->objects.size());
+            for (auto &obj : node->objects)
+                objects_.push_back(obj);
+            payloads_.insert(payloads_.end(), node->payloads.begin(), node->payloads.end());
+            if (node->isLeaf())
+                continue;
+            nodes_[i].firstChild = static_cast<unsigned int>(nodes_.size());
+            for (auto &child : node->children)
+            {
+                order.push_back(child);
+                nodes_.push_back(LinearNode{});
+                nodeBounds_.push_back(*child);
+            }
+        }
+        objects_.pad();
+        nodes_.shrink_to_fit();
+        nodeBounds_.shrink_to_fit();
+        objects_.shrink_to_fit();
+        payloads_.shrink_to_fit();
+        releaseNodes();
+    }
+    // 批量构建: 按质心的Morton码基数排序后一次性生成线性布局, 不经过指针树
+    // 物体放在能完全容纳它的最深层格子里, 与逐个insert的查询结果相同
+    void bulkBuild(const std::vector<Bounds> &objects,
+                   const std::vector<Payload> &payloads,
+                   unsigned int threads = 1)
+    {
+        assert(root_ && root_->objects.empty() && root_->isLeaf()); // 只能用于空树
+        assert(objects.size() == payloads.size());
+        int maxDepth = params_.maxDepth;
+        unsigned int maxObjects = static_cast<unsigned int>(params_.maxObjects);
+        // 1. 计算Morton码与每个物体能下沉到的层, 可多线程
+        std::vector<unsigned int> codes(objects.size());
+        std::vector<int> levels(objects.size());
+        auto encode = [&](std::size_t begin, std::size_t end)
+        {
+            float cells = static_cast<float>(1u << maxDepth);
+            // 平的网格(比如地面)某一轴厚度为0, 按最小正数除, 该轴全部落在第0格
+            glm::vec3 size = glm::max(bounds_.size(), glm::vec3(std::numeric_limits<float>::min()));
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                glm::vec3 rel = (objects[i].centre() - bounds_.min) / size * cells;
+                assert(!std::isnan(rel.x) && !std::isnan(rel.y) && !std::isnan(rel.z)); // NaN转unsigned是未定义行为
+                unsigned int x = static_cast<unsigned int>(glm::clamp(rel.x, 0.0f, cells - 1.0f));
+                unsigned int y = static_cast<unsigned int>(glm::clamp(rel.y, 0.0f, cells - 1.0f));
+                unsigned int z = static_cast<unsigned int>(glm::clamp(rel.z, 0.0f, cells - 1.0f));
+                codes[i] = expandBits(x) | (expandBits(y) << 1) | (expandBits(z) << 2);
+                levels[i] = -1; // 与根节点不相交, 丢弃(同insert)
+                if (!bounds_.intersects(objects[i]))
+                    continue;
+                levels[i] = 0;
+                for (int level = maxDepth; level > 0; --level)
+                {
+                    int shift = maxDepth - level;
+                    if (cellBounds(level, x >> shift, y >> shift, z >> shift).contains(objects[i]))
+                    {
+                        levels[i] = level;
+                        break;
+                    }
+                }
+            }
+        };
+        std::size_t chunk = std::max<std::size_t>(OCTREE_BULK_MIN_CHUNK, (objects.size() + threads - 1) / std::max(1u, threads));
+        std::vector<std::jthread> workers;
+        for (std::size_t begin = chunk; begin < objects.size(); begin += chunk)
+            workers.emplace_back(encode, begin, std::min(objects.size(), begin + chunk));
+        encode(0, std::min(objects.size(), chunk));
+        workers.clear();
+        // 2. 按Morton码基数排序(每趟8位)
+        std::vector<unsigned int> order(objects.size()), buffer(objects.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            order[i] = static_cast<unsigned int>(i);
+        for (int pass = 0; pass * 8 < 3 * maxDepth; ++pass)
+        {
+            unsigned int histogram[257] = {0};
+            for (auto i : order)
+                ++histogram[((codes[i] >> (pass * 8)) & 0xFF) + 1];
+            for (int b = 0; b < 256; ++b)
+                histogram[b + 1] += histogram[b];
+            for (auto i : order)
+                buffer[histogram[(codes[i] >> (pass * 8)) & 0xFF]++] = i;
+            order.swap(buffer);
+        }
+        // 3. 按层展开: 同一子树的物体在排序后连续, 子节点区间用二分查找切出
+        struct Pending
+        {
+            int level;
+            unsigned int x, y, z;
+            std::size_t begin, end;
+        };
+        nodes_.clear();
+        nodeBounds_.clear();
+        objects_.clear();
+        payloads_.clear();
+        std::vector<Pending> pending{Pending{0, 0, 0, 0, 0, order.size()}};
+        nodes_.push_back(LinearNode{});
+        nodeBounds_.push_back(bounds_);
+        for (std::size_t n = 0; n < pending.size(); ++n)
+        {
+            Pending p = pending[n];
+            unsigned int count = 0;
+            for (std::size_t i = p.begin; i < p.end; ++i)
+                count += levels[order[i]] >= p.level;
+            bool leaf = count <= maxObjects || p.level == maxDepth;
+            nodes_[n].firstObject = static_cast<unsigned int>(payloads_.size());
+            for (std::size_t i = p.begin; i < p.end; ++i)
+            {
+                int level = levels[order[i]];
+                if (level == p.level || (leaf && level > p.level))
+                {
+                    objects_.push_back(objects[order[i]]);
+                    payloads_.push_back(payloads[order[i]]);
+                }
+            }
+            nodes_[n].objectCount = static_cast<unsigned int>(payloads_.size()) - nodes_[n].firstObject;
+            if (leaf)
+                continue;
+            nodes_[n].firstChild = static_cast<unsigned int>(nodes_.size());
+            int shift = 3 * (maxDepth - p.level - 1);
+            std::size_t begin = p.begin;
+            for (unsigned int c = 0; c < 8; ++c)
+            {
+                std::size_t end = std::partition_point(order.begin() + begin, order.begin() + p.end,
+                                                       [&](unsigned int i)
+                                                       { return ((codes[i] >> shift) & 7) <= c; }) -
+                                  order.begin();
+                unsigned int x = 2 * p.x + (c & 1), y = 2 * p.y + ((c >> 1) & 1), z = 2 * p.z + ((c >> 2) & 1);
+                pending.push_back(Pending{p.level + 1, x, y, z, begin, end});
+                nodes_.push_back(LinearNode{});
+                nodeBounds_.push_back(cellBounds(p.level + 1, x, y, z));
+                begin = end;
+            }
+        }
+        objects_.pad();
+        nodes_.shrink_to_fit();
+        nodeBounds_.shrink_to_fit();
+        objects_.shrink_to_fit();
+        payloads_.shrink_to_fit();
+        releaseNodes();
+    }
+    // 二进制缓存: 按段写出线性布局, 载荷经encode(Payload) -> std::uint32_t转成编号, 文件里不含指针
+    // 段顺序: bounds, 构建参数, 节点数, 物体数, nodes, nodeBounds, objects(不含填充), 编号
+    template <typename Encode>
+    void save(std::ostream &out, Encode &&encode) const
     {
-        assert(root_);
-        root_->insert(obj);
+        assert(isLinear());
+        auto write = [&](const void *data, std::size_t size)
+        { out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size)); };
+        std::uint32_t nodeCount = static_cast<std::uint32_t>(nodes_.size());
+        std::uint32_t objectCount = static_cast<std::uint32_t>(payloads_.size());
+        std::int32_t params[2] = {params_.maxDepth, params_.maxObjects};
+        write(&bounds_, sizeof(Bounds));
+        write(params, sizeof(params));
+        write(&nodeCount, sizeof(nodeCount));
+        write(&objectCount, sizeof(objectCount));
+        write(nodes_.data(), nodeCount * sizeof(LinearNode));
+        for (std::size_t i = 0; i < nodeCount; ++i)
+        {
+            Bounds bounds = nodeBounds_[i];
+            write(&bounds, sizeof(Bounds));
+        }
+        for (std::size_t i = 0; i < objectCount; ++i)
+        {
+            Bounds bounds = objects_[i];
+            write(&bounds, sizeof(Bounds));
+        }
+        for (auto where : payloads_)
+        {
+            std::uint32_t id = encode(where);
+            write(&id, sizeof(id));
+        }
     }
-    std::vector<AABB> query(const AABB &range) const
+    // 从[cursor, end)读回save写出的布局, 成功后cursor移到末尾; 数据不完整或不一致时返回false且树不变
+    // decode(std::uint32_t, Payload &)把编号转回载荷, 编号无效时返回false
+    // 子节点须排在父节点之后(linearize与bulkBuild都按层序), 否则损坏的文件可能让遍历成环
+    template <typename Decode>
+    bool load(const char *&cursor, const char *end, Decode &&decode)
+    {
+        const char *p = cursor;
+        auto read = [&](void *data, std::size_t size)
+        {
+            if (static_cast<std::size_t>(end - p) < size)
+                return false;
+            std::memcpy(data, p, size);
+            p += size;
+            return true;
+        };
+        Bounds bounds;
+        std::int32_t params[2] = {0, 0};
+        std::uint32_t nodeCount = 0, objectCount = 0;
+        if (!read(&bounds, sizeof(Bounds)) || !read(params, sizeof(params)) ||
+            params[0] < 0 || params[0] > OCTREE_DEPTH_LIMIT || params[1] <= 0 ||
+            !read(&nodeCount, sizeof(nodeCount)) || !read(&objectCount, sizeof(objectCount)) ||
+            0 == nodeCount ||
+            static_cast<std::size_t>(end - p) < nodeCount * (sizeof(LinearNode) + sizeof(Bounds)) +
+                                                    objectCount * (sizeof(Bounds) + sizeof(std::uint32_t)))
+            return false;
+        BasicOctree octree;
+        octree.bounds_ = bounds;
+        octree.params_ = OctreeParams{params[0], params[1]};
+        octree.nodes_.resize(nodeCount);
+        read(octree.nodes_.data(), nodeCount * sizeof(LinearNode));
+        for (std::uint32_t i = 0; i < nodeCount; ++i)
+        {
+            auto &node = octree.nodes_[i];
+            if ((0 != node.firstChild && (node.firstChild <= i || nodeCount < 8 || node.firstChild > nodeCount - 8)) ||
+                node.firstObject > objectCount || node.objectCount > objectCount - node.firstObject)
+                return false;
+        }
+        for (std::uint32_t i = 0; i < nodeCount; ++i)
+        {
+            read(&bounds, sizeof(Bounds));
+            octree.nodeBounds_.push_back(bounds);
+        }
+        // 根节点的盒子就是整棵树的盒子
+        Bounds root = octree.nodeBounds_[0];
+        if (!(root.min == octree.bounds_.min) || !(root.max == octree.bounds_.max))
+            return false;
+        for (std::uint32_t i = 0; i < objectCount; ++i)
+        {
+            read(&bounds, sizeof(Bounds));
+            octree.objects_.push_back(bounds);
+        }
+        octree.objects_.pad();
+        octree.payloads_.resize(objectCount);
+        for (auto &where : octree.payloads_)
+        {
+            std::uint32_t id = 0;
+            read(&id, sizeof(id));
+            if (!decode(id, where))
+                return false;
+        }
+        *this = std::move(octree);
+        cursor = p;
+        return true;
+    }
+    inline bool isLinear() const { return !nodes_.empty(); }
+    inline bool isBuilt() const { return nullptr != root_ || isLinear(); }
+    inline void insert(const Bounds &obj, Payload where)
+    {
+        assert(root_); // 已经linearize()的树不能再插入
+        root_->insert(obj, where);
+    }
+    // AABB只能带void *载荷
+    std::vector<AABB> query(const Bounds &range) const
+        requires std::is_same_v<Payload, void *>
     {
-        assert(root_);
         std::vector<AABB> result;
-        root_->query(range, result);
+        visit(range, [&](const Bounds &obj, Payload where)
+              { result.emplace_back(obj, where); });
         return result;
     }
+    // 不分配内存的查询: 只把命中物体的where交给visitor
+    template <typename Visitor>
+    inline void query(const Bounds &range, Visitor &&visitor) const
+    {
+        visit(range, [&](const Bounds &, Payload where)
+              { visitor(where); });
+    }
+    // 追加到调用者持有的缓冲区(不清空), 缓冲区容量够用时不分配内存
+    inline void query(const Bounds &range, std::vector<Payload> &result) const
+    {
+        visit(range, [&](const Bounds &, Payload where)
+              { result.push_back(where); });
+    }
+    // 批量查询: 一次遍历回答多个范围, visitor(std::size_t range, Payload where)中range为ranges中的下标
+    // 每OCTREE_BATCH_WIDTH个范围为一组, 节点上用位掩码记录仍与之相交的范围, 向下逐层收缩
+    template <typename Visitor>
+    void query(const std::vector<Bounds> &ranges, Visitor &&visitor) const
+    {
+        assert(isBuilt());
+        for (std::size_t first = 0; first < ranges.size(); first += OCTREE_BATCH_WIDTH)
+        {
+            std::size_t count = std::min<std::size_t>(OCTREE_BATCH_WIDTH, ranges.size() - first);
+            if (!isLinear()) // 指针树只在构建期存在, 逐个查询即可
+            {
+                for (std::size_t r = first; r < first + count; ++r)
+                {
+                    auto single = [&](const Bounds &, Payload where)
+                    { visitor(r, where); };
+                    root_->query(ranges[r], single);
+                }
+                continue;
+            }
+            std::uint64_t active = 0;
+            for (std::size_t r = 0; r < count; ++r)
+                active |= static_cast<std::uint64_t>(nodeBounds_[0].intersects(ranges[first + r])) << r;
+            if (active)
+                queryBatchLinear(0, ranges.data() + first, active, [&](std::size_t r, Payload where)
+                                 { visitor(first + r, where); });
+        }
+    }
+    // 按范围分别追加到results[i](不清空, results不够长时补齐)
+    inline void query(const std::vector<Bounds> &ranges, std::vector<std::vector<Payload>> &results) const
+    {
+        if (results.size() < ranges.size())
+            results.resize(ranges.size());
+        query(ranges, [&](std::size_t r, Payload where)
+              { results[r].push_back(where); });
+    }
+    // 球体/胶囊体查询: 节点和物体都按到球心(或球心轨迹)的真实距离剪枝, 比外接盒查询少得多的候选
+    template <typename Visitor>
+    inline void query(const Sphere &sphere, Visitor &&visitor) const { visitShape(sphere, visitor); }
+    template <typename Visitor>
+    inline void query(const Capsule &capsule, Visitor &&visitor) const { visitShape(capsule, visitor); }
+    // 视锥查询: 与视锥相交(或在其内)的物体交给visitor(Payload where)
+    template <typename Visitor>
+    void query(const Frustum &frustum, Visitor &&visitor) const
+    {
+        assert(isBuilt());
+        if (!isLinear())
+            root_->cull(frustum, false, visitor);
+        else
+            cullLinear(0, frustum, false, visitor);
+    }
+    // 射线查询: 子节点按进入距离由近到远访问, 与射线相交的物体交给visitor(Payload where, float &tMax)
+    // visitor缩短tMax即为最近命中, 更远的节点随之被剪掉; 返回true立即结束, 即任意命中
+    // 返回值表示是否被visitor提前结束
+    template <typename Visitor>
+    bool raycast(const Ray &ray, float tMax, Visitor &&visitor) const
+    {
+        assert(isBuilt());
+        float tEnter;
+        if (!isLinear())
+            return root_->intersectRay(ray, tMax, tEnter) && root_->raycast(ray, tMax, visitor);
+        return nodeBounds_[0].intersectRay(ray, tMax, tEnter) && raycastLinear(0, ray, tMax, visitor);
+    }
+    // 最近物体查询(分支限界): 子节点按到point的距离由近到远访问, 包围盒距离平方不超过maxDistance2的物体
+    // 交给visitor(Payload where, float &maxDistance2); visitor算出真实距离后缩小maxDistance2, 更远的节点随之被剪掉
+    // k近邻同样用它: visitor保留k个最好结果, 满k后把第k个的距离平方写回
+    template <typename Visitor>
+    void nearest(const glm::vec3 &point, float maxDistance2, Visitor &&visitor) const
+    {
+        assert(isBuilt());
+        if (!isLinear())
+        {
+            if (root_->distance2(point) <= maxDistance2)
+                root_->nearest(point, maxDistance2, visitor);
+        }
+        else if (nodeBounds_[0].distance2(point) <= maxDistance2)
+            nearestLinear(0, point, maxDistance2, visitor);
+    }
+    inline const OctreeParams &getParams() const { return params_; }
+    // 形状与内存统计; 给出workload时顺带统计其中每个查询平均进入的节点数(剪枝与query相同)
+    OctreeStats getStats(const std::vector<Bounds> &workload = std::vector<Bounds>()) const
+    {
+        assert(isBuilt());
+        OctreeStats stats;
+        auto record = [&](std::size_t depth, std::size_t objects, bool leaf)
+        {
+            if (stats.nodesPerDepth.size() <= depth)
+            {
+                stats.nodesPerDepth.resize(depth + 1, 0);
+                stats.objectsPerDepth.resize(depth + 1, 0);
+            }
+            ++stats.nodeCount;
+            ++stats.nodesPerDepth[depth];
+            stats.objectsPerDepth[depth] += objects;
+            stats.objectCount += objects;
+            if (leaf)
+            {
+                ++stats.leafCount;
+                stats.emptyLeafCount += 0 == objects;
+                stats.leafObjects += objects;
+                stats.maxLeafObjects = std::max(stats.maxLeafObjects, objects);
+                stats.depth = std::max(stats.depth, depth);
+            }
+            else
+                stats.internalObjects += objects;
+        };
+        if (isLinear())
+        {
+            statsLinear(0, 0, record);
+            for (auto soa : {&nodeBounds_, &objects_})
+                stats.memoryBytes += soa->minX.capacity() * 6 * sizeof(float);
+            stats.memoryBytes += nodes_.capacity() * sizeof(LinearNode) + payloads_.capacity() * sizeof(Payload);
+        }
+        else
+            statsNode(root_, record, stats.memoryBytes);
+        for (auto &range : workload)
+            stats.visitedNodes += isLinear() ? (nodeBounds_[0].intersects(range) ? visitedLinear(0, range) : 0)
+                                             : visitedNode(root_, range);
+        stats.queryCount = workload.size();
+        return stats;
+    }
     inline const glm::vec3 &getMin() const
     {
-        assert(root_);
-        return root_->min;
+        assert(isBuilt());
+        return bounds_.min;
     }
     inline const glm::vec3 &getMax() const
     {
-        assert(root_);
-        return root_->max;
+        assert(isBuilt());
+        return bounds_.max;
     }
-    inline const glm::vec3 &getCentre() const
+    inline glm::vec3 getCentre() const
     {
-        assert(root_);
-        return root_->centre;
+        assert(isBuilt());
+        return bounds_.centre();
     }
-    inline const glm::vec3 &getSize() const
+    inline glm::vec3 getSize() const
     {
-        assert(root_);
-        return root_->size;
+        assert(isBuilt());
+        return bounds_.size();
     }
-    inline AABB getGlobalAABB(const glm::vec3 &position = glm::vec3(0.0f)) const
+    inline Bounds getGlobalAABB(const glm::vec3 &position = glm::vec3(0.0f)) const
     {
-        assert(root_);
-        return AABB(root_->min + position, root_->max + position, root_->where);
+        assert(isBuilt());
+        return bounds_.getGlobalAABB(position);
     }
-    inline AABB getDeltaAABB(const glm::vec3 &position, const glm::vec3 &prePosition) const
+    inline Bounds getDeltaAABB(const glm::vec3 &position, const glm::vec3 &prePosition) const
     {
-        assert(root_);
-        AABB deltaAABB(root_->min + position, root_->max + position, root_->where);
+        assert(isBuilt());
+        Bounds deltaAABB = bounds_.getGlobalAABB(position);
         if (prePosition.x < 0.0f)
             deltaAABB.min.x += prePosition.x;
         else
@@ -220,9 +749,234 @@ public:
     }
     inline void print() const
     {
-        assert(root_);
-        root_->print();
+        assert(isBuilt());
+        if (isLinear())
+            printLinear(0);
+        else
+            root_->print();
+    }
+
+private:
+    // 逐个析构节点(释放物体数组)后整池归还
+    inline void releaseNodes()
+    {
+        if (root_)
+            destroy(root_);
+        root_ = nullptr;
+        pool_.reset();
+    }
+    // 节点在池里, 只调用析构函数不delete
+    static void destroy(OctreeNode *node)
+    {
+        if (!node->isLeaf())
+            for (auto child : node->children)
+                destroy(child);
+        node->~OctreeNode();
+    }
+    // 10位整数的每一位之间插入两个0
+    static inline unsigned int expandBits(unsigned int v)
+    {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+    // level层第(x, y, z)个格子; 用同一公式计算, 保证父格子总是包含子格子
+    inline Bounds cellBounds(int level, unsigned int x, unsigned int y, unsigned int z) const
+    {
+        float cells = static_cast<float>(1u << level);
+        glm::vec3 size = bounds_.size();
+        return Bounds(bounds_.min + size * (glm::vec3(x, y, z) / cells),
+                      bounds_.min + size * (glm::vec3(x + 1, y + 1, z + 1) / cells));
+    }
+    template <typename Visitor>
+    void visit(const Bounds &range, Visitor &&visitor) const
+    {
+        assert(isBuilt());
+        if (!isLinear())
+            root_->query(range, visitor);
+        else if (nodeBounds_[0].intersects(range))
+            queryLinear(0, range, visitor);
+    }
+    // 调用前已确认idx节点与range相交
+    template <typename Visitor>
+    void queryLinear(unsigned int idx, const Bounds &range, Visitor &visitor) const
+    {
+        auto &node = nodes_[idx];
+        Overlap::testRange(objects_, node.firstObject, node.objectCount, range, [&](std::size_t i)
+                           { visitor(objects_[i], payloads_[i]); });
+        if (0 == node.firstChild)
+            return;
+        for (unsigned int mask = Overlap::test8(nodeBounds_, node.firstChild, range); mask; mask &= mask - 1)
+            queryLinear(node.firstChild + std::countr_zero(mask), range, visitor);
+    }
+    // active中第r位表示ranges[r]与idx节点相交
+    template <typename Visitor>
+    void queryBatchLinear(unsigned int idx, const Bounds *ranges, std::uint64_t active, const Visitor &visitor) const
+    {
+        auto &node = nodes_[idx];
+        std::uint64_t childActive[8] = {0};
+        for (std::uint64_t bits = active; bits; bits &= bits - 1)
+        {
+            std::size_t r = std::countr_zero(bits);
+            Overlap::testRange(objects_, node.firstObject, node.objectCount, ranges[r], [&](std::size_t i)
+                               { visitor(r, payloads_[i]); });
+            if (0 != node.firstChild)
+                for (unsigned int mask = Overlap::test8(nodeBounds_, node.firstChild, ranges[r]); mask; mask &= mask - 1)
+                    childActive[std::countr_zero(mask)] |= std::uint64_t(1) << r;
+        }
+        for (unsigned int c = 0; c < 8; ++c)
+            if (childActive[c])
+                queryBatchLinear(node.firstChild + c, ranges, childActive[c], visitor);
+    }
+    template <typename Shape, typename Visitor>
+    void visitShape(const Shape &shape, Visitor &visitor) const
+    {
+        assert(isBuilt());
+        Bounds range = shape.getBounds();
+        if (!isLinear())
+            root_->queryShape(shape, range, visitor);
+        else if (nodeBounds_[0].intersects(range) && shape.intersects(nodeBounds_[0]))
+            queryShapeLinear(0, shape, range, visitor);
+    }
+    // 调用前已确认idx节点与shape相交; 批量盒测试先筛掉外接盒之外的, 剩下的再算距离
+    template <typename Shape, typename Visitor>
+    void queryShapeLinear(unsigned int idx, const Shape &shape, const Bounds &range, Visitor &visitor) const
+    {
+        auto &node = nodes_[idx];
+        Overlap::testRange(objects_, node.firstObject, node.objectCount, range, [&](std::size_t i)
+                           {
+                               if (shape.intersects(objects_[i]))
+                                   visitor(payloads_[i]); });
+        if (0 == node.firstChild)
+            return;
+        for (unsigned int mask = Overlap::test8(nodeBounds_, node.firstChild, range); mask; mask &= mask - 1)
+        {
+            unsigned int child = node.firstChild + std::countr_zero(mask);
+            if (shape.intersects(nodeBounds_[child]))
+                queryShapeLinear(child, shape, range, visitor);
+        }
+    }
+    template <typename Visitor>
+    void cullLinear(unsigned int idx, const Frustum &frustum, bool inside, Visitor &visitor) const
+    {
+        if (!inside)
+        {
+            auto side = frustum.classify(nodeBounds_[idx]);
+            if (side == Frustum::Side::OUTSIDE)
+                return;
+            inside = side == Frustum::Side::INSIDE;
+        }
+        auto &node = nodes_[idx];
+        for (unsigned int i = node.firstObject; i < node.firstObject + node.objectCount; ++i)
+            if (inside || frustum.intersects(objects_[i]))
+                visitor(payloads_[i]);
+        if (0 != node.firstChild)
+            for (unsigned int i = node.firstChild; i < node.firstChild + 8; ++i)
+                cullLinear(i, frustum, inside, visitor);
+    }
+    template <typename Visitor>
+    bool raycastLinear(unsigned int idx, const Ray &ray, float &tMax, Visitor &visitor) const
+    {
+        auto &node = nodes_[idx];
+        float tEnter;
+        for (unsigned int i = node.firstObject; i < node.firstObject + node.objectCount; ++i)
+            if (objects_[i].intersectRay(ray, tMax, tEnter) && visitor(payloads_[i], tMax))
+                return true;
+        if (0 == node.firstChild)
+            return false;
+        std::pair<float, unsigned int> order[8];
+        int count = 0;
+        for (unsigned int i = node.firstChild; i < node.firstChild + 8; ++i)
+            if (nodeBounds_[i].intersectRay(ray, tMax, tEnter))
+                order[count++] = {tEnter, i};
+        std::sort(order, order + count, [](const auto &a, const auto &b)
+                  { return a.first < b.first; });
+        for (int i = 0; i < count; ++i)
+            if (order[i].first <= tMax && raycastLinear(order[i].second, ray, tMax, visitor))
+                return true;
+        return false;
+    }
+    template <typename Visitor>
+    void nearestLinear(unsigned int idx, const glm::vec3 &point, float &maxDistance2, Visitor &visitor) const
+    {
+        auto &node = nodes_[idx];
+        if (0 != node.firstChild)
+        {
+            std::pair<float, unsigned int> order[8];
+            int count = 0;
+            for (unsigned int i = node.firstChild; i < node.firstChild + 8; ++i)
+                if (float d2 = nodeBounds_[i].distance2(point); d2 <= maxDistance2)
+                    order[count++] = {d2, i};
+            std::sort(order, order + count, [](const auto &a, const auto &b)
+                      { return a.first < b.first; });
+            for (int i = 0; i < count; ++i)
+                if (order[i].first <= maxDistance2)
+                    nearestLinear(order[i].second, point, maxDistance2, visitor);
+        }
+        // 以point为中心, 当前最近距离为半边长的立方体先用SIMD筛一遍, 再算真实距离
+        float radius = std::sqrt(maxDistance2);
+        Overlap::testRange(objects_, node.firstObject, node.objectCount,
+                           Bounds(point - glm::vec3(radius), point + glm::vec3(radius)), [&](std::size_t i)
+                           {
+                               if (objects_[i].distance2(point) <= maxDistance2)
+                                   visitor(payloads_[i], maxDistance2); });
+    }
+    template <typename Record>
+    void statsLinear(unsigned int idx, std::size_t depth, Record &record) const
+    {
+        auto &node = nodes_[idx];
+        record(depth, node.objectCount, 0 == node.firstChild);
+        if (0 != node.firstChild)
+            for (unsigned int i = node.firstChild; i < node.firstChild + 8; ++i)
+                statsLinear(i, depth + 1, record);
+    }
+    template <typename Record>
+    static void statsNode(const OctreeNode *node, Record &record, std::size_t &memoryBytes)
+    {
+        record(static_cast<std::size_t>(node->depth), node->objects.size(), node->isLeaf());
+        memoryBytes += sizeof(OctreeNode) + node->objects.capacity() * sizeof(Bounds) + node->payloads.capacity() * sizeof(Payload);
+        for (auto child : node->children)
+            if (child)
+                statsNode(child, record, memoryBytes);
+    }
+    // 调用前已确认idx节点与range相交
+    std::size_t visitedLinear(unsigned int idx, const Bounds &range) const
+    {
+        std::size_t visited = 1;
+        auto &node = nodes_[idx];
+        if (0 != node.firstChild)
+            for (unsigned int mask = Overlap::test8(nodeBounds_, node.firstChild, range); mask; mask &= mask - 1)
+                visited += visitedLinear(node.firstChild + std::countr_zero(mask), range);
+        return visited;
+    }
+    static std::size_t visitedNode(const OctreeNode *node, const Bounds &range)
+    {
+        if (!node->intersects(range))
+            return 0;
+        std::size_t visited = 1;
+        for (auto child : node->children)
+            if (child)
+                visited += visitedNode(child, range);
+        return visited;
+    }
+    void printLinear(unsigned int idx) const
+    {
+        auto &node = nodes_[idx];
+        std::cout << "\nnode:" << idx << std::endl;
+        nodeBounds_[idx].print();
+        std::cout << "\nobjects:" << std::endl;
+        for (unsigned int i = node.firstObject; i < node.firstObject + node.objectCount; ++i)
+            objects_[i].print();
+        std::cout << "\nchildren:" << std::endl;
+        if (0 != node.firstChild)
+            for (unsigned int i = 0; i < 8; ++i)
+                printLinear(node.firstChild + i);
     }
 };
 
-#endif
\ No newline at end of file
+using Octree = BasicOctree<>;
+using TriangleOctree = BasicOctree<std::uint32_t>; // 载荷为三角形序号, 顶点下标是indices[3 * 序号 + 0, 1, 2]
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef OCTREE_CACHE_HPP
+#define OCTREE_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include "octree.hpp"
+#include "mapped_file.hpp"
+
+#define OCTREE_CACHE_MAGIC 0x5443334du // "M3CT"
+#define OCTREE_CACHE_VERSION 2u        // 布局有变化时加1, 旧缓存自动作废
+#define OCTREE_CACHE_EXTENSION ".octree"
+#define OCTREE_PARAMS_EXTENSION ".octree.cfg"
+
+// 模型的网格八叉树缓存, 写在资源文件旁边(boxes.fbx -> boxes.fbx.octree), 以只读mmap方式读回
+// 文件头: magic, version, 资源修改时间, 资源路径长度与路径, 网格数, 各网格偏移
+// 之后按网格顺序存放TriangleOctree::save的输出(含构建参数), 载荷本身就是三角形序号, 原样写出
+// 构建参数另存在可以随资源提交的文本文件里(boxes.fbx.octree.cfg), 没有时按三角形数估算
+class OctreeCache
+{
+    MappedFile file_;
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+    std::vector<std::uint64_t> offsets_;
+    bool valid_ = false;
+    std::atomic<bool> stale_ = false; // 有网格没能从缓存读出, 需要重写; Model在工作线程上并行load
+    bool tuned_ = false;
+    OctreeParams params_;
+
+public:
+    // 打开并校验缓存; 文件不存在, 版本不符或资源已被修改时valid()为false
+    explicit OctreeCache(const std::filesystem::path &asset)
+    {
+        std::error_code ec;
+        tuned_ = loadParams(asset, params_);
+        auto cache = getPath(asset);
+        if (!std::filesystem::exists(cache, ec) || !file_.map(cache))
+            return;
+        data_ = file_.data();
+        size_ = file_.size();
+        const char *cursor = data_, *end = data_ + size_;
+        auto read = [&](void *data, std::size_t size)
+        {
+            if (static_cast<std::size_t>(end - cursor) < size)
+                return false;
+            std::memcpy(data, cursor, size);
+            cursor += size;
+            return true;
+        };
+        std::uint32_t magic = 0, version = 0, pathLength = 0, meshCount = 0;
+        std::int64_t stamp = 0;
+        if (!read(&magic, sizeof(magic)) || OCTREE_CACHE_MAGIC != magic ||
+            !read(&version, sizeof(version)) || OCTREE_CACHE_VERSION != version ||
+            !read(&stamp, sizeof(stamp)) || getStamp(asset) != stamp ||
+            !read(&pathLength, sizeof(pathLength)) || static_cast<std::size_t>(end - cursor) < pathLength ||
+            std::string(cursor, pathLength) != asset.generic_string())
+            return;
+        cursor += pathLength;
+        if (!read(&meshCount, sizeof(meshCount)) || static_cast<std::size_t>(end - cursor) / sizeof(std::uint64_t) < meshCount)
+            return;
+        offsets_.resize(meshCount);
+        read(offsets_.data(), meshCount * sizeof(std::uint64_t));
+        for (auto offset : offsets_)
+            if (offset > size_)
+                return;
+        valid_ = true;
+    }
+    ~OctreeCache() = default;
+    OctreeCache(const OctreeCache &) = delete;
+    OctreeCache &operator=(const OctreeCache &) = delete;
+    OctreeCache(OctreeCache &&) = delete;
+    OctreeCache &operator=(OctreeCache &&) = delete;
+    inline bool valid() const { return valid_; }
+    // 缓存不可用或有网格重新构建过
+    inline bool stale() const { return !valid_ || stale_; }
+    inline std::size_t size() const { return offsets_.size(); }
+    // 有cfg文件时所有网格用同一组参数, 否则按三角形数估算
+    inline OctreeParams getParams(std::size_t triangleCount) const
+    {
+        return tuned_ ? params_ : OctreeParams::fromCount(triangleCount);
+    }
+    // 读出第mesh个网格的八叉树; 构建参数与params不同, 包围盒与导入的网格bounds不同,
+    // 或有三角形序号不小于triangleCount(截断写入或手动拷来的缓存)都算失败
+    bool load(std::size_t mesh, TriangleOctree &octree, const OctreeParams &params,
+              const Bounds &bounds, std::size_t triangleCount)
+    {
+        TriangleOctree loaded;
+        const char *cursor = data_ + (mesh < offsets_.size() ? offsets_[mesh] : 0);
+        if (!valid_ || mesh >= offsets_.size() ||
+            !loaded.load(cursor, data_ + size_, [triangleCount](std::uint32_t id, std::uint32_t &where)
+                         { where = id;
+                           return id < triangleCount; }) ||
+            loaded.getParams() != params ||
+            !(loaded.getGlobalAABB().min == bounds.min) || !(loaded.getGlobalAABB().max == bounds.max))
+        {
+            stale_ = true;
+            return false;
+        }
+        octree = std::move(loaded);
+        return true;
+    }
+    // 按网格顺序写出; 先写临时文件再改名, 写不了(比如只读目录)时返回false
+    static bool save(const std::filesystem::path &asset, const std::vector<const TriangleOctree *> &meshes)
+    {
+        std::error_code ec;
+        auto cache = getPath(asset);
+        auto temp = cache;
+        temp += ".tmp";
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            auto write = [&](const void *data, std::size_t size)
+            { out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size)); };
+            std::string path = asset.generic_string();
+            std::uint32_t header[2] = {OCTREE_CACHE_MAGIC, OCTREE_CACHE_VERSION};
+            std::int64_t stamp = getStamp(asset);
+            std::uint32_t pathLength = static_cast<std::uint32_t>(path.size());
+            std::uint32_t meshCount = static_cast<std::uint32_t>(meshes.size());
+            write(header, sizeof(header));
+            write(&stamp, sizeof(stamp));
+            write(&pathLength, sizeof(pathLength));
+            write(path.data(), path.size());
+            write(&meshCount, sizeof(meshCount));
+            // 偏移表先占位, 写完各网格后回填
+            auto tablePos = out.tellp();
+            std::vector<std::uint64_t> offsets(meshes.size(), 0);
+            write(offsets.data(), offsets.size() * sizeof(std::uint64_t));
+            for (std::size_t i = 0; i < meshes.size(); ++i)
+            {
+                offsets[i] = static_cast<std::uint64_t>(out.tellp());
+                meshes[i]->save(out, [](std::uint32_t where)
+                                { return where; });
+            }
+            out.seekp(tablePos);
+            write(offsets.data(), offsets.size() * sizeof(std::uint64_t));
+            if (!out)
+                return false;
+        }
+        std::filesystem::rename(temp, cache, ec);
+        if (ec)
+            std::filesystem::remove(temp, ec);
+        return !ec;
+    }
+    static inline std::filesystem::path getPath(const std::filesystem::path &asset)
+    {
+        auto cache = asset;
+        cache += OCTREE_CACHE_EXTENSION;
+        return cache;
+    }
+    // cfg格式: 每行"键 值", 目前有maxDepth与maxObjects, 缺项取默认值
+    static bool loadParams(const std::filesystem::path &asset, OctreeParams &params)
+    {
+        auto path = asset;
+        path += OCTREE_PARAMS_EXTENSION;
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        OctreeParams loaded;
+        std::string key;
+        int value;
+        while (in >> key >> value)
+            if ("maxDepth" == key)
+                loaded.maxDepth = value;
+            else if ("maxObjects" == key)
+                loaded.maxObjects = value;
+        if (loaded.maxDepth < 0 || loaded.maxDepth > OCTREE_DEPTH_LIMIT || loaded.maxObjects <= 0)
+            return false;
+        params = loaded;
+        return true;
+    }
+    static bool saveParams(const std::filesystem::path &asset, const OctreeParams &params)
+    {
+        auto path = asset;
+        path += OCTREE_PARAMS_EXTENSION;
+        std::ofstream out(path, std::ios::trunc);
+        out << "maxDepth " << params.maxDepth << "\n"
+            << "maxObjects " << params.maxObjects << "\n";
+        return out.good();
+    }
+
+private:
+    static inline std::int64_t getStamp(const std::filesystem::path &asset)
+    {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(asset, ec);
+        return ec ? 0 : static_cast<std::int64_t>(time.time_since_epoch().count());
+    }
+};
+
+#endif
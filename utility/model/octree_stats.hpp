@@ -0,0 +1,107 @@
+#ifndef OCTREE_STATS_HPP
+#define OCTREE_STATS_HPP
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+// 八叉树的形状统计, 由Octree::getStats()填写
+// 叶子之外的物体(internalObjects)是跨越子格子边界而无法下沉的物体, 比例过高说明格子划分与物体尺寸不匹配
+struct OctreeStats
+{
+    std::size_t nodeCount = 0;
+    std::size_t leafCount = 0;
+    std::size_t emptyLeafCount = 0;
+    std::size_t depth = 0;                        // 实际最深叶子所在层
+    std::vector<std::size_t> nodesPerDepth;       // 深度直方图
+    std::vector<std::size_t> objectsPerDepth;
+    std::size_t objectCount = 0;
+    std::size_t leafObjects = 0;
+    std::size_t internalObjects = 0;
+    std::size_t maxLeafObjects = 0;
+    std::size_t memoryBytes = 0;
+    std::size_t queryCount = 0;                   // 统计时传入的查询数
+    std::size_t visitedNodes = 0;                 // 这些查询共访问的节点数
+
+    inline double averageLeafObjects() const
+    {
+        return leafCount == 0 ? 0.0 : static_cast<double>(leafObjects) / leafCount;
+    }
+    inline double averageVisitedNodes() const
+    {
+        return queryCount == 0 ? 0.0 : static_cast<double>(visitedNodes) / queryCount;
+    }
+    // 每棵树一行, 名字总加引号(RFC 4180), 直方图用'|'分隔放在一列里; header为true时先写表头
+    void writeCSV(std::ostream &out, const std::string &name, bool header = false) const
+    {
+        if (header)
+            out << "name,nodes,leaves,emptyLeaves,depth,objects,leafObjects,internalObjects,"
+                   "maxLeafObjects,avgLeafObjects,memoryBytes,queries,avgVisitedNodes,nodesPerDepth,objectsPerDepth\n";
+        writeField(out, name);
+        out << ',' << nodeCount << ',' << leafCount << ',' << emptyLeafCount << ',' << depth << ','
+            << objectCount << ',' << leafObjects << ',' << internalObjects << ','
+            << maxLeafObjects << ',' << averageLeafObjects() << ',' << memoryBytes << ','
+            << queryCount << ',' << averageVisitedNodes() << ',';
+        writeList(out, nodesPerDepth, "|");
+        out << ',';
+        writeList(out, objectsPerDepth, "|");
+        out << '\n';
+    }
+    void writeJSON(std::ostream &out, const std::string &name) const
+    {
+        out << "{\"name\":";
+        writeString(out, name);
+        out << ",\"nodes\":" << nodeCount
+            << ",\"leaves\":" << leafCount
+            << ",\"emptyLeaves\":" << emptyLeafCount
+            << ",\"depth\":" << depth
+            << ",\"objects\":" << objectCount
+            << ",\"leafObjects\":" << leafObjects
+            << ",\"internalObjects\":" << internalObjects
+            << ",\"maxLeafObjects\":" << maxLeafObjects
+            << ",\"avgLeafObjects\":" << averageLeafObjects()
+            << ",\"memoryBytes\":" << memoryBytes
+            << ",\"queries\":" << queryCount
+            << ",\"avgVisitedNodes\":" << averageVisitedNodes()
+            << ",\"nodesPerDepth\":[";
+        writeList(out, nodesPerDepth, ",");
+        out << "],\"objectsPerDepth\":[";
+        writeList(out, objectsPerDepth, ",");
+        out << "]}";
+    }
+
+private:
+    // JSON字符串: 转义引号, 反斜杠与控制字符
+    static void writeString(std::ostream &out, const std::string &text)
+    {
+        static const char *hex = "0123456789abcdef";
+        out << '"';
+        for (unsigned char c : text)
+            if ('"' == c || '\\' == c)
+                out << '\\' << c;
+            else if (c < 0x20)
+                out << "\\u00" << hex[c >> 4] << hex[c & 0xF];
+            else
+                out << c;
+        out << '"';
+    }
+    // CSV字段: 加引号, 内部的引号写两遍, 逗号与换行原样留在引号内
+    static void writeField(std::ostream &out, const std::string &text)
+    {
+        out << '"';
+        for (char c : text)
+        {
+            if ('"' == c)
+                out << '"';
+            out << c;
+        }
+        out << '"';
+    }
+    static void writeList(std::ostream &out, const std::vector<std::size_t> &list, const char *separator)
+    {
+        for (std::size_t i = 0; i < list.size(); ++i)
+            out << (i == 0 ? "" : separator) << list[i];
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef TEXTURE_DECODER_HPP
+#define TEXTURE_DECODER_HPP
+
+#include <cassert>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <stb/stb_image.h>
+#include "baked_texture.hpp"
+
+// 解码好的一张图, 像素由stbi分配; 有烘焙文件时只填baked
+struct DecodedImage
+{
+    std::size_t index = 0; // 在TextureDecoder输入中的序号
+    std::uint64_t hash = 0;
+    std::size_t fileSize = 0;
+    int width = 0;
+    int height = 0;
+    int comp = 0;
+    std::unique_ptr<unsigned char, void (*)(void *)> pixels{nullptr, stbi_image_free};
+    BakedTexture baked;
+};
+
+// 纹理的解码阶段, 不碰GL: 工作线程读文件, 算内容哈希并解码, 每完成一张就放进队列
+// 原图旁有有效的烘焙文件(BakedTexture)时读它, 不再解码; compressed为false时(驱动不支持S3TC)跳过BC格式的烘焙文件
+// GL线程用pop()按完成顺序取出上传, 解码与上传重叠; threads为0时在pop()里逐张解码, 即串行路径
+class TextureDecoder
+{
+    std::vector<std::filesystem::path> paths_;
+    std::deque<DecodedImage> queue_; // 先完成的在前
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::atomic<std::size_t> next_ = 0;
+    std::size_t popped_ = 0;
+    bool compressed_;
+    std::vector<std::jthread> workers_;
+
+public:
+    TextureDecoder(std::vector<std::filesystem::path> paths, unsigned int threads, bool compressed = true)
+        : paths_(std::move(paths)), compressed_(compressed)
+    {
+        threads = static_cast<unsigned int>(std::min<std::size_t>(threads, paths_.size()));
+        workers_.reserve(threads);
+        for (unsigned int t = 0; t < threads; ++t)
+            workers_.emplace_back([this]
+                                  {
+                                      for (std::size_t i = next_++; i < paths_.size(); i = next_++)
+                                      {
+                                          DecodedImage image = decode(i, paths_[i], compressed_);
+                                          std::lock_guard<std::mutex> lock(mutex_);
+                                          queue_.push_back(std::move(image));
+                                          ready_.notify_one();
+                                      } });
+    }
+    // 没取完就销毁时, 工作线程做完手上这张就退出
+    ~TextureDecoder()
+    {
+        next_ = paths_.size();
+        workers_.clear();
+    }
+    TextureDecoder(const TextureDecoder &) = delete;
+    TextureDecoder &operator=(const TextureDecoder &) = delete;
+    TextureDecoder(TextureDecoder &&) = delete;
+    TextureDecoder &operator=(TextureDecoder &&) = delete;
+    // 取出下一张解码完成的图, 全部取完后返回false
+    // wait为false时不等待, 还没有解码完成的图也返回false, 用done()区分
+    bool pop(DecodedImage &image, bool wait = true)
+    {
+        if (done())
+            return false;
+        if (workers_.empty())
+        {
+            image = decode(popped_, paths_[popped_], compressed_);
+            ++popped_;
+            return true;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (wait)
+            ready_.wait(lock, [this]
+                        { return !queue_.empty(); });
+        else if (queue_.empty())
+            return false;
+        image = std::move(queue_.front());
+        queue_.pop_front();
+        ++popped_;
+        return true;
+    }
+    inline bool done() const { return popped_ == paths_.size(); }
+    // FNV-1a
+    static std::uint64_t hashContent(const std::vector<unsigned char> &content)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (auto byte : content)
+        {
+            hash ^= byte;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+private:
+    static std::vector<unsigned char> readFile(const std::filesystem::path &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<unsigned char>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+    static DecodedImage decode(std::size_t index, const std::filesystem::path &path, bool compressed)
+    {
+        DecodedImage image;
+        image.index = index;
+        std::error_code ec;
+        if (auto baked = BakedTexture::getPath(path); std::filesystem::exists(baked, ec))
+        {
+            std::vector<unsigned char> content = readFile(baked);
+            if (image.baked.parse(content.data(), content.size(), path) && (compressed || !image.baked.isCompressed()))
+            {
+                image.hash = hashContent(content);
+                image.fileSize = content.size();
+                image.width = image.baked.width;
+                image.height = image.baked.height;
+                return image;
+            }
+            image.baked = BakedTexture();
+        }
+        std::vector<unsigned char> content = readFile(path);
+        assert(!content.empty());
+        image.hash = hashContent(content);
+        image.fileSize = content.size();
+        image.pixels.reset(stbi_load_from_memory(content.data(), static_cast<int>(content.size()),
+                                                 &image.width, &image.height, &image.comp, 0));
+        assert(image.pixels != nullptr);
+        return image;
+    }
+};
+
+#endif
@@ -198,7 +198,7 @@ public:
         return *this;
     }
     inline float getRadius() const { return radius_; }
-    inline const glm::vec3 &getCentre() const { return getOctree().getCentre(); }
+    inline glm::vec3 getCentre() const { return getOctree().getCentre(); }
 };
 
 #endif
\ No newline at end of file
@@ -1,9 +1,14 @@
 #ifndef GROUND_HPP
 #define GROUND_HPP
 
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <filesystem>
 #include <glm/glm.hpp>
 #include <glm/gtx/intersect.hpp>
 #include "collider.hpp"
+#include "loose_octree.hpp"
 
 #define DECAY_RATE 0.9f // 为了简化，所有mesh的动量衰减系数都一样
 #define FRICTION_RATE 0.9f
@@ -11,21 +16,62 @@
 class Ground : public Animator
 {
     std::unordered_map<std::string, Collider> colliders_;
+    std::unordered_map<std::string, unsigned int> colliderHandles_; // colliderIndex_中的句柄
+    LooseOctree colliderIndex_;                                     // 每帧更新的碰撞体扫掠盒, 用于碰撞体之间的检测
+    std::vector<Bounds> deltaAABBs_;                                // 每帧所有碰撞体的扫掠盒
+    std::vector<std::vector<void *>> meshHits_;                     // 没有场景索引时, 批量查询模型八叉树得到的网格
+    std::unordered_map<std::string, float> sphereRadii_;            // 按球体加入的碰撞体的半径
+    std::vector<std::optional<Capsule>> capsules_;                  // 每帧球体碰撞体的扫掠胶囊体, 与deltaAABBs_一一对应
+    std::ofstream workload_;                                        // 打开时逐帧记录扫掠盒, 见recordWorkload()
     float precision_ = 0.1f;
 
 public:
-    Ground(Animator &&entity) : Animator(std::move(entity)) {}
+    // sceneIndex为true时为地面建场景三角形索引, 碰撞查询不论地面分成多少个网格都只遍历一次
+    Ground(Animator &&entity, bool sceneIndex = true)
+        : Animator(std::move(entity)),
+          colliderIndex_(getOctree().getGlobalAABB())
+    {
+        if (sceneIndex)
+            buildSceneIndex();
+    }
     ~Ground() { colliders_.clear(); }
     Ground(const Ground &) = delete;
     Ground &operator=(const Ground &) = delete;
     Ground(Ground &&) = delete;
     Ground &operator=(Ground &&) = delete;
-    inline void addCollider(const std::string &name, Collider &&collider) { colliders_.emplace(name, std::move(collider)); }
+    inline void addCollider(const std::string &name, Collider &&collider)
+    {
+        auto [it, inserted] = colliders_.emplace(name, std::move(collider));
+        if (inserted)
+            colliderHandles_.emplace(name, colliderIndex_.insert(it->second.getOctree().getGlobalAABB(it->second.myPosition()), &it->second));
+    }
+    // 球体碰撞体按扫掠胶囊体查询地面三角形, 只有真正可能接触的三角形进入窄相
+    inline void addCollider(const std::string &name, Collider_sphere &&collider)
+    {
+        float radius = collider.getRadius();
+        if (!colliders_.contains(name))
+            sphereRadii_.emplace(name, radius);
+        addCollider(name, static_cast<Collider &&>(collider));
+    }
     inline Collider &getCollider(const std::string &name) { return colliders_.at(name); }
+    // 之后每帧把所有碰撞体的扫掠盒(地面的模型空间)追加到path, 每行"minX minY minZ maxX maxY maxZ"
+    // 即my3D_bench --workload读取的格式, 用真实的查询负载调参; 空路径停止记录
+    bool recordWorkload(const std::filesystem::path &path)
+    {
+        workload_.close();
+        if (path.empty())
+            return true;
+        workload_.open(path, std::ios::app);
+        workload_.precision(9); // float往返不丢精度
+        return workload_.is_open();
+    }
     void update(float deltaTime) // (s)
     {
         // 所有检测对象都有的力
         auto g = Ground::gravityAcc();
+        // 先算出所有碰撞体本帧的外力与扫掠盒, 一次遍历网格八叉树回答全部扫掠盒
+        deltaAABBs_.clear();
+        capsules_.clear();
         for (auto &it : colliders_)
         {
             auto &collider = it.second;
@@ -34,17 +80,70 @@ public:
             // collider.myOuterAcceleration() += buoyancy(1.0f, 1.0f, g) / collider.getMass();
             // 运动就会有的力
             collider.myOuterAcceleration() += resistance(0.1f, collider.myVelocity()) / collider.getMass();
-            // 碰撞就会有的力
             auto v0 = collider.myVelocity();
             auto v = v0 + (collider.myInnerAcceleration() + collider.myOuterAcceleration()) * deltaTime;
             glm::vec3 prePosition = (v0 + v) * deltaTime * 0.5f;
-            AABB deltaAABB = collider.getOctree().getDeltaAABB(collider.myPosition(), prePosition);
-            for (auto &aabb : getOctree().query(deltaAABB))
-                collidingOffset(collider, aabb, deltaAABB);
+            if (auto sphere = sphereRadii_.find(it.first); sphere != sphereRadii_.end())
+            {
+                glm::vec3 centre = collider.myPosition() + collider.getOctree().getCentre();
+                capsules_.emplace_back(Capsule(centre, centre + prePosition, sphere->second));
+                deltaAABBs_.push_back(capsules_.back()->getBounds());
+            }
+            else
+            {
+                capsules_.emplace_back();
+                deltaAABBs_.push_back(collider.getOctree().getDeltaAABB(collider.myPosition(), prePosition));
+            }
+            // 登记的盒子与下面查询用的是同一个, 相交关系对称, 每对从双方都能找到, 只处理一次不会漏
+            colliderIndex_.update(colliderHandles_.at(it.first), deltaAABBs_.back());
+        }
+        if (workload_.is_open())
+            for (auto &box : deltaAABBs_)
+                workload_ << box.min.x << ' ' << box.min.y << ' ' << box.min.z << ' '
+                          << box.max.x << ' ' << box.max.y << ' ' << box.max.z << '\n';
+        if (!hasSceneIndex())
+        {
+            for (auto &hits : meshHits_)
+                hits.clear();
+            getOctree().query(deltaAABBs_, meshHits_);
+        }
+        // 先处理所有碰撞, 再统一积分: 任何一对碰撞体都在双方更新位置之前解决
+        std::size_t i = 0;
+        for (auto &it : colliders_)
+        {
+            auto &collider = it.second;
+            // 碰撞就会有的力; 球体用胶囊体, 其余用扫掠盒
+            auto narrowPhase = [&](const auto &range)
+            {
+                if (hasSceneIndex())
+                    getSceneIndex().query(range, [&](MeshTriangle hit)
+                                          { collidingOffset(collider, getMeshes()[hit.mesh], hit.triangle); });
+                else
+                    for (auto where : meshHits_[i])
+                        collidingOffset(collider, *static_cast<const Mesh *>(where), range);
+            };
+            if (capsules_[i])
+                narrowPhase(*capsules_[i]);
+            else
+                narrowPhase(deltaAABBs_[i]);
+            ++i;
+        }
+        i = 0;
+        for (auto &it : colliders_)
+        {
+            auto &collider = it.second;
+            colliderIndex_.query(deltaAABBs_[i++], [&](void *where)
+                                 {
+                auto other = static_cast<Collider *>(where);
+                if (std::less<Collider *>{}(&collider, other)) // 每对只处理一次
+                    collidingOffset(collider, *other); });
+        }
+        for (auto &it : colliders_)
+        {
+            auto &collider = it.second;
             collider.myVelocity() += (collider.myInnerAcceleration() + collider.myOuterAcceleration()) * deltaTime;
             collider.myPosition() += collider.myVelocity() * deltaTime;
             collider.processDecay();
-            collider.print(); ////////////////////////////////////////////////////////////////////////
         }
     }
 
@@ -74,53 +173,56 @@ private:
             resistanceMag *= speed;
         return -glm::normalize(v) * resistanceMag;
     }
-    void collidingOffset(Collider &collider, const AABB &aabb, const AABB &deltaAABB)
+    // range为扫掠盒(Bounds)或球体的扫掠胶囊体(Capsule)
+    template <typename Range>
+    void collidingOffset(Collider &collider, const Mesh &mesh, const Range &range)
     {
-        const Mesh &mesh = *reinterpret_cast<Mesh *>(aabb.where);
-        for (auto &triangle : mesh.getOctree().query(deltaAABB))
-        {
-            auto p = reinterpret_cast<GLuint *>(triangle.where);
-            auto &v0 = mesh.getVertices()[*p];
-            auto &v1 = mesh.getVertices()[*(p + 1)];
-            auto &v2 = mesh.getVertices()[*(p + 2)];
-            auto edge1 = v1.position - v0.position;
-            auto edge2 = v2.position - v0.position;
-            auto normal = glm::normalize(glm::cross(edge1, edge2));
-            auto iacc = glm::dot(normal, collider.myInnerAcceleration());
-            auto oacc = glm::dot(normal, collider.myOuterAcceleration());
-            auto vel = glm::dot(normal, collider.myVelocity());
-            glm::vec3 v_perpendicular = collider.myVelocity() - vel * normal;
-            glm::vec3 frictionDir = glm::vec3(0.0f);
-            if (glm::length2(v_perpendicular) > 1e-6f)
-                frictionDir = -glm::normalize(v_perpendicular);
-            if (oacc < 0.0f)
-            {
-                collider.myOuterAcceleration() += glm::abs(oacc) * FRICTION_RATE * frictionDir;
-                collider.myOuterAcceleration() -= oacc * normal;
-            }
-            if (iacc < 0.0f)
-            {
-                collider.myOuterAcceleration() += glm::abs(iacc) * FRICTION_RATE * frictionDir;
-                collider.myInnerAcceleration() -= iacc * normal;
-            }
-            if (vel < 0.0f)
-                collider.myVelocity() -= (1.0f + DECAY_RATE) * vel * normal;
-        }
+        mesh.query(range, [&](std::uint32_t triangle)
+                   { collidingOffset(collider, mesh, triangle); });
     }
-    void collidingOffset(Collider_sphere &collider, const Mesh &mesh, const AABB &deltaAABB)
+    void collidingOffset(Collider &collider, const Mesh &mesh, std::uint32_t triangle)
     {
-        for (auto &aabb : mesh.getOctree().query(deltaAABB)) // capsule
+        auto p = mesh.getTriangle(triangle);
+        auto &v0 = mesh.getVertices()[*p];
+        auto &v1 = mesh.getVertices()[*(p + 1)];
+        auto &v2 = mesh.getVertices()[*(p + 2)];
+        auto edge1 = v1.position - v0.position;
+        auto edge2 = v2.position - v0.position;
+        auto normal = glm::normalize(glm::cross(edge1, edge2));
+        auto iacc = glm::dot(normal, collider.myInnerAcceleration());
+        auto oacc = glm::dot(normal, collider.myOuterAcceleration());
+        auto vel = glm::dot(normal, collider.myVelocity());
+        glm::vec3 v_perpendicular = collider.myVelocity() - vel * normal;
+        glm::vec3 frictionDir = glm::vec3(0.0f);
+        if (glm::length2(v_perpendicular) > 1e-6f)
+            frictionDir = -glm::normalize(v_perpendicular);
+        if (oacc < 0.0f)
         {
-            auto p = reinterpret_cast<GLuint *>(aabb.where);
-            auto &v0 = mesh.getVertices()[*p];
-            auto &v1 = mesh.getVertices()[*(p + 1)];
-            auto &v2 = mesh.getVertices()[*(p + 2)];
-            auto edge1 = v1.position - v0.position;
-            auto edge2 = v2.position - v0.position;
-            auto normal = glm::normalize(glm::cross(edge1, edge2));
-            glm::vec2 intersection;
-            float distance = 0.0f;
+            collider.myOuterAcceleration() += glm::abs(oacc) * FRICTION_RATE * frictionDir;
+            collider.myOuterAcceleration() -= oacc * normal;
         }
+        if (iacc < 0.0f)
+        {
+            collider.myOuterAcceleration() += glm::abs(iacc) * FRICTION_RATE * frictionDir;
+            collider.myInnerAcceleration() -= iacc * normal;
+        }
+        if (vel < 0.0f)
+            collider.myVelocity() -= (1.0f + DECAY_RATE) * vel * normal;
+    }
+    // 两个碰撞体之间: 沿中心连线做带衰减的动量交换
+    void collidingOffset(Collider &collider, Collider &other)
+    {
+        glm::vec3 normal = other.myPosition() + other.getOctree().getCentre() -
+                           collider.myPosition() - collider.getOctree().getCentre();
+        if (glm::length2(normal) < 1e-12f)
+            return;
+        normal = glm::normalize(normal);
+        float vel = glm::dot(collider.myVelocity() - other.myVelocity(), normal);
+        if (vel <= 0.0f) // 正在分离
+            return;
+        float impulse = (1.0f + DECAY_RATE) * vel / (1.0f / collider.getMass() + 1.0f / other.getMass());
+        collider.myVelocity() -= impulse / collider.getMass() * normal;
+        other.myVelocity() += impulse / other.getMass() * normal;
     }
 };
 